@@ -0,0 +1,104 @@
+#include "lib/audit.h"
+#include <sys/wait.h>
+
+/*
+Decoder for the --audit-log ring.
+
+    usage: minishell-audit [--json] FILE
+
+Prints the live records oldest first.
+*/
+
+static void print_string_json(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') printf("\\%c", *s);
+        else if ((unsigned char) *s < 0x20) printf("\\u%04x", *s);
+        else putchar(*s);
+    }
+    putchar('"');
+}
+
+static void format_status(int status, char *buf, size_t size) {
+    if (WIFSIGNALED(status)) snprintf(buf, size, "signal %d", WTERMSIG(status));
+    else snprintf(buf, size, "exit %d", WEXITSTATUS(status));
+}
+
+static void print_text(audit_record *r) {
+    char status[32];
+    uint32_t i;
+
+    format_status(r->status, status, sizeof(status));
+    printf("#%llu pgid %d %s %.3fs start %lld.%09lld user %.6fs sys %.6fs maxrss %lldkB\n",
+           (unsigned long long) r->sequence, r->pgid, status,
+           (r->end_ns - r->start_ns) / 1e9,
+           (long long) (r->start_ns / 1000000000), (long long) (r->start_ns % 1000000000),
+           r->utime_us / 1e6, r->stime_us / 1e6, (long long) r->maxrss_kb);
+    printf("    %s\n", r->command);
+    for (i = 0; i < r->process_count && i < AUDIT_MAX_PROCESSES; i++) {
+        format_status(r->statuses[i], status, sizeof(status));
+        printf("    pid %d %s\n", r->pids[i], status);
+    }
+}
+
+static void print_json(audit_record *r) {
+    uint32_t i;
+
+    printf("{\"sequence\":%llu,\"pgid\":%d,\"status\":%d,\"exit\":%d,\"signal\":%d,"
+           "\"start_ns\":%lld,\"end_ns\":%lld,\"utime_us\":%lld,\"stime_us\":%lld,"
+           "\"maxrss_kb\":%lld,\"minflt\":%lld,\"majflt\":%lld,\"nvcsw\":%lld,\"nivcsw\":%lld,"
+           "\"process_count\":%u,\"processes\":[",
+           (unsigned long long) r->sequence, r->pgid, r->status,
+           WIFEXITED(r->status) ? WEXITSTATUS(r->status) : -1,
+           WIFSIGNALED(r->status) ? WTERMSIG(r->status) : 0,
+           (long long) r->start_ns, (long long) r->end_ns,
+           (long long) r->utime_us, (long long) r->stime_us, (long long) r->maxrss_kb,
+           (long long) r->minflt, (long long) r->majflt,
+           (long long) r->nvcsw, (long long) r->nivcsw, r->process_count);
+    for (i = 0; i < r->process_count && i < AUDIT_MAX_PROCESSES; i++) {
+        printf("%s{\"pid\":%d,\"status\":%d}", i ? "," : "", r->pids[i], r->statuses[i]);
+    }
+    printf("],\"command\":");
+    print_string_json(r->command);
+    printf("}\n");
+}
+
+int main(int argc, char *argv[]) {
+    audit_log *log;
+    audit_record record, *slot;
+    uint64_t next, n, first;
+    int json = 0, argi = 1;
+
+    if (argi < argc && strcmp(argv[argi], "--json") == 0) {
+        json = 1;
+        argi++;
+    }
+    if (argi + 1 != argc) {
+        fprintf(stderr, "usage: minishell-audit [--json] FILE\n");
+        return 2;
+    }
+
+    log = audit_map(argv[argi]);
+    if (!log) {
+        fprintf(stderr, "minishell-audit: %s: not a readable audit log\n", argv[argi]);
+        return 1;
+    }
+
+    next = __atomic_load_n(&log->header->next, __ATOMIC_ACQUIRE);
+    first = next > log->header->capacity ? next - log->header->capacity : 0;
+
+    for (n = first; n < next; n++) {
+        /* skip slots being rewritten or never completed, and copies
+           that raced with a writer reusing the slot */
+        slot = &log->records[n % log->header->capacity];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != n + 1) continue;
+        record = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != n + 1) continue;
+        record.command[AUDIT_COMMAND_SIZE - 1] = '\0';
+
+        if (json) print_json(&record);
+        else print_text(&record);
+    }
+    return 0;
+}
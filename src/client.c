@@ -0,0 +1,152 @@
+#include <poll.h>
+#include "lib/server.h"
+
+/*
+Minimal client for `main --server PATH`.
+
+    usage: minishell-client [-c] SOCKET COMMAND...
+
+With -c the job's stdout and stderr are captured by the server and
+copied to ours.  Exits with the job's exit status.
+*/
+
+static int connect_server(const char *path) {
+    struct sockaddr_un addr = { 0 };
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock < 0) return -1;
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static int recv_fds(int sock, int *out, int *err) {
+    char byte;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg;
+    int fds[2];
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(sock, &msg, 0) != 1) return -1;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+            cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    *out = fds[0];
+    *err = fds[1];
+    return 0;
+}
+
+/* Copy both captured streams until the job closes them.  */
+static void drain_output(int out, int err) {
+    struct pollfd fds[2] = {
+        { .fd = out, .events = POLLIN },
+        { .fd = err, .events = POLLIN },
+    };
+    int targets[2] = { STDOUT_FILENO, STDERR_FILENO };
+    char buffer[4096];
+    int open_fds = 2, i;
+    ssize_t n;
+
+    while (open_fds > 0) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (i = 0; i < 2; i++) {
+            if (fds[i].fd < 0 || !fds[i].revents) continue;
+            n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                write(targets[i], buffer, n);
+            } else {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                open_fds--;
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    server_request request = { 0 };
+    server_response response;
+    char command[SERVER_MAX_COMMAND];
+    size_t length = 0, n;
+    int argi = 1, sock, out, err, i;
+
+    if (argi < argc && strcmp(argv[argi], "-c") == 0) {
+        request.flags |= SERVER_CAPTURE_OUTPUT;
+        argi++;
+    }
+    if (argc - argi < 2) {
+        fprintf(stderr, "usage: minishell-client [-c] SOCKET COMMAND...\n");
+        return 2;
+    }
+
+    for (i = argi + 1; i < argc; i++) {
+        n = strlen(argv[i]);
+        if (length + n + 1 >= sizeof(command)) {
+            fprintf(stderr, "minishell-client: command too long\n");
+            return 2;
+        }
+        if (length > 0) command[length++] = ' ';
+        memcpy(command + length, argv[i], n);
+        length += n;
+    }
+    request.length = length;
+
+    sock = connect_server(argv[argi]);
+    if (sock < 0) {
+        perror("minishell-client: connect");
+        return 2;
+    }
+
+    if (write(sock, &request, sizeof(request)) != sizeof(request) ||
+            write(sock, command, length) != (ssize_t) length) {
+        perror("minishell-client: write");
+        return 2;
+    }
+
+    if (request.flags & SERVER_CAPTURE_OUTPUT) {
+        if (recv_fds(sock, &out, &err) < 0) {
+            fprintf(stderr, "minishell-client: server did not pass output fds\n");
+            return 2;
+        }
+        drain_output(out, err);
+    }
+
+    if (read(sock, &response, sizeof(response)) != sizeof(response)) {
+        fprintf(stderr, "minishell-client: connection closed\n");
+        return 2;
+    }
+    if (response.error != SERVER_OK) {
+        fprintf(stderr, "minishell-client: server error %d\n", response.error);
+        return 2;
+    }
+
+    fprintf(stderr, "status %d, user %ld.%06lds, sys %ld.%06lds, maxrss %ldkB\n",
+            response.status,
+            (long) response.usage.ru_utime.tv_sec, (long) response.usage.ru_utime.tv_usec,
+            (long) response.usage.ru_stime.tv_sec, (long) response.usage.ru_stime.tv_usec,
+            response.usage.ru_maxrss);
+
+    if (WIFSIGNALED(response.status)) return 128 + WTERMSIG(response.status);
+    return WEXITSTATUS(response.status);
+}
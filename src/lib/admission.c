@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "admission.h"
+
+/*
+Admission control for background jobs.
+
+Linux pressure stall information reports, per resource, the share of
+wall time in which at least one runnable task was stalled waiting for
+it ("some"), averaged over 10, 60 and 300 seconds.  avg10 reacts within
+a few seconds of a burst, loadavg is kept as a fallback for kernels
+built without CONFIG_PSI.  A resource whose figure cannot be read never
+holds a job back.
+*/
+
+void admission_limits_init(admission_limits *limits) {
+    limits->cpu_some = -1;
+    limits->memory_some = -1;
+    limits->load = -1;
+}
+
+bool admission_enabled(admission_limits *limits) {
+    return limits->cpu_some >= 0 || limits->memory_some >= 0 || limits->load >= 0;
+}
+
+static double read_pressure(const char *path) {
+    FILE *file = fopen(path, "r");
+    double avg10;
+
+    if (!file) return -1;
+    if (fscanf(file, "some avg10=%lf", &avg10) != 1) avg10 = -1;
+    fclose(file);
+    return avg10;
+}
+
+static double read_load() {
+    FILE *file = fopen(ADMISSION_LOADAVG, "r");
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    double load;
+
+    if (!file) return -1;
+    if (fscanf(file, "%lf", &load) != 1) load = -1;
+    fclose(file);
+    if (load < 0) return -1;
+    return cpus > 0 ? load / cpus : load;
+}
+
+void admission_sample_read(admission_sample *sample) {
+    sample->cpu_some = read_pressure(ADMISSION_CPU_PRESSURE);
+    sample->memory_some = read_pressure(ADMISSION_MEMORY_PRESSURE);
+    sample->load = read_load();
+}
+
+static bool within(double limit, double value) {
+    return limit < 0 || value < 0 || value <= limit;
+}
+
+bool admission_allows(admission_limits *limits, admission_sample *sample) {
+    return within(limits->cpu_some, sample->cpu_some) &&
+        within(limits->memory_some, sample->memory_some) &&
+        within(limits->load, sample->load);
+}
@@ -0,0 +1,29 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdbool.h>
+
+#define ADMISSION_POLL_MS 1000
+#define ADMISSION_CPU_PRESSURE "/proc/pressure/cpu"
+#define ADMISSION_MEMORY_PRESSURE "/proc/pressure/memory"
+#define ADMISSION_LOADAVG "/proc/loadavg"
+
+/* A negative limit is not checked.  */
+typedef struct admission_limits {
+    double cpu_some;        /* % of time some task stalled on CPU, avg10 */
+    double memory_some;     /* same for memory */
+    double load;            /* 1-minute load average per online CPU */
+} admission_limits;
+
+typedef struct admission_sample {
+    double cpu_some;        /* -1 when PSI is not available */
+    double memory_some;
+    double load;
+} admission_sample;
+
+void admission_limits_init(admission_limits *limits);
+bool admission_enabled(admission_limits *limits);
+void admission_sample_read(admission_sample *sample);
+bool admission_allows(admission_limits *limits, admission_sample *sample);
+
+#endif
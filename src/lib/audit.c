@@ -0,0 +1,146 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "audit.h"
+
+static int64_t timespec_ns(struct timespec *ts) {
+    return (int64_t) ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int64_t timeval_us(struct timeval *tv) {
+    return (int64_t) tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static audit_log *map_log(int fd, size_t size, int prot) {
+    audit_log *log = (audit_log *) malloc(sizeof(audit_log));
+    void *base;
+
+    if (!log) return NULL;
+    base = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        free(log);
+        return NULL;
+    }
+    log->header = (audit_header *) base;
+    log->records = (audit_record *) ((char *) base + sizeof(audit_header));
+    log->size = size;
+    return log;
+}
+
+static int header_is_valid(audit_header *header, size_t size) {
+    return header->magic == AUDIT_MAGIC &&
+        header->version == AUDIT_VERSION &&
+        header->record_size == sizeof(audit_record) &&
+        header->capacity > 0 &&
+        sizeof(audit_header) + (size_t) header->capacity * sizeof(audit_record) <= size;
+}
+
+/* Open, or create with room for capacity records, the ring at path.
+   An existing log keeps its own capacity.  */
+audit_log *audit_open(const char *path, uint32_t capacity) {
+    size_t size = sizeof(audit_header) + (size_t) capacity * sizeof(audit_record);
+    audit_log *log;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "minishell: %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    if (st.st_size == 0) {
+        if (capacity == 0 || ftruncate(fd, size) < 0) {
+            fprintf(stderr, "minishell: %s: cannot size audit log\n", path);
+            close(fd);
+            return NULL;
+        }
+    } else {
+        size = st.st_size;
+    }
+
+    log = map_log(fd, size, PROT_READ | PROT_WRITE);
+    close(fd);
+    if (!log) {
+        fprintf(stderr, "minishell: %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    if (st.st_size == 0) {
+        log->header->version = AUDIT_VERSION;
+        log->header->record_size = sizeof(audit_record);
+        log->header->capacity = capacity;
+        log->header->next = 0;
+        __atomic_store_n(&log->header->magic, AUDIT_MAGIC, __ATOMIC_RELEASE);
+    } else if (!header_is_valid(log->header, size)) {
+        fprintf(stderr, "minishell: %s: not a minishell audit log\n", path);
+        munmap(log->header, size);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+/* Map an existing log read-only, for decoders.  */
+audit_log *audit_map(const char *path) {
+    audit_log *log;
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0 || fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(audit_header)) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    log = map_log(fd, st.st_size, PROT_READ);
+    close(fd);
+    if (log && !header_is_valid(log->header, log->size)) {
+        munmap(log->header, log->size);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+/* Append one record for a finished job.  Slots are reserved with an
+   atomic increment, so several shells (or server workers) may share a
+   log.  The sequence number is stored last and marks the record as
+   complete.  Nothing is synced: the pages belong to the page cache and
+   survive the shell crashing.  */
+void audit_job(audit_log *log, job *j) {
+    uint64_t n = __atomic_fetch_add(&log->header->next, 1, __ATOMIC_RELAXED);
+    audit_record *record = &log->records[n % log->header->capacity];
+    process *p;
+    uint32_t count = 0;
+
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    /* readers must see the slot invalidated before any of it changes */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset((char *) record + sizeof(record->sequence), 0,
+           sizeof(audit_record) - sizeof(record->sequence));
+
+    record->start_ns = timespec_ns(&j->start_time);
+    record->end_ns = timespec_ns(&j->end_time);
+    record->pgid = j->pgid;
+    strncpy(record->command, j->command, AUDIT_COMMAND_SIZE - 1);
+
+    for (p = j->root_process; p; p = p->next, count++) {
+        if (count < AUDIT_MAX_PROCESSES) {
+            record->pids[count] = p->pid;
+            record->statuses[count] = p->status;
+        }
+        record->utime_us += timeval_us(&p->usage.ru_utime);
+        record->stime_us += timeval_us(&p->usage.ru_stime);
+        if (p->usage.ru_maxrss > record->maxrss_kb) record->maxrss_kb = p->usage.ru_maxrss;
+        record->minflt += p->usage.ru_minflt;
+        record->majflt += p->usage.ru_majflt;
+        record->nvcsw += p->usage.ru_nvcsw;
+        record->nivcsw += p->usage.ru_nivcsw;
+    }
+    record->process_count = count;
+    if (j->root_process) record->status = job_last_stage(j)->status;
+
+    __atomic_store_n(&record->sequence, n + 1, __ATOMIC_RELEASE);
+}
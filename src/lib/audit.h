@@ -0,0 +1,60 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "parser.h"
+
+#define AUDIT_MAGIC 0x4441534d     /* "MSAD" */
+#define AUDIT_VERSION 1
+#define AUDIT_DEFAULT_RECORDS 4096
+#define AUDIT_COMMAND_SIZE 256
+#define AUDIT_MAX_PROCESSES 8
+
+/*
+On-disk layout: one audit_header followed by `capacity` fixed-size
+audit_record slots.  Record n (counting from 0) lives in slot
+n % capacity and carries sequence n + 1 once fully written, so a
+reader can tell live records from stale or half-written ones.
+*/
+typedef struct audit_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint64_t next;          /* records ever reserved */
+    uint8_t reserved[40];
+} audit_header;
+
+typedef struct audit_record {
+    uint64_t sequence;
+    int64_t start_ns;       /* CLOCK_REALTIME */
+    int64_t end_ns;
+    int32_t pgid;
+    int32_t status;         /* wait(2) status of the last process */
+    uint32_t process_count; /* may exceed AUDIT_MAX_PROCESSES */
+    uint32_t reserved;
+    int32_t pids[AUDIT_MAX_PROCESSES];
+    int32_t statuses[AUDIT_MAX_PROCESSES];
+    /* summed over all processes of the job, maxrss is the largest */
+    int64_t utime_us;
+    int64_t stime_us;
+    int64_t maxrss_kb;
+    int64_t minflt;
+    int64_t majflt;
+    int64_t nvcsw;
+    int64_t nivcsw;
+    char command[AUDIT_COMMAND_SIZE];
+} audit_record;
+
+typedef struct audit_log {
+    audit_header *header;
+    audit_record *records;
+    size_t size;
+} audit_log;
+
+audit_log *audit_open(const char *path, uint32_t capacity);
+audit_log *audit_map(const char *path);
+void audit_job(audit_log *log, job *j);
+
+#endif
@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include "fanout.h"
+
+/*
+Kernel-side data pump for `cmd >(a) >(b) > file`.
+
+The producer writes into a pipe (the source).  tee(2) duplicates the
+unread contents of the source into each target pipe without consuming
+them, and once every target holds a copy of the first m bytes they are
+dropped from the source by splicing them into /dev/null.  Regular files
+get a private intermediate pipe which is spliced into the file.  Only
+page references move; the data itself never enters user space.
+
+tee always copies from the head of the source, so a target that is
+already ahead of the head must not be teed again until the head has
+caught up with it.  `ahead` tracks, per target, how many bytes past the
+head it has received.
+*/
+
+typedef struct pump_target {
+    int fd;             /* pipe to tee into, -1 once the reader is gone */
+    int file;           /* regular file behind fd, or -1 */
+    int file_pipe;      /* read end of the intermediate pipe for file */
+    size_t ahead;
+} pump_target;
+
+typedef struct fanout_pump {
+    int source;
+    int devnull;
+    int count;
+    pump_target *targets;
+} fanout_pump;
+
+static void close_target(pump_target *t) {
+    if (t->fd >= 0) close(t->fd);
+    if (t->file >= 0) close(t->file);
+    if (t->file_pipe >= 0) close(t->file_pipe);
+    t->fd = t->file = t->file_pipe = -1;
+}
+
+/* Move everything teed into a file target's intermediate pipe into
+   the file.  */
+static int drain_to_file(pump_target *t, size_t len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = splice(t->file_pipe, NULL, t->file, NULL, len, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Drop len bytes from the head of the source.  */
+static int consume(fanout_pump *pump, size_t len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = splice(pump->source, NULL, pump->devnull, NULL, len, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        len -= n;
+    }
+    return 0;
+}
+
+static void *run_pump(void *arg) {
+    fanout_pump *pump = arg;
+    struct pollfd *fds = malloc((pump->count + 1) * sizeof(struct pollfd));
+    size_t min;
+    ssize_t n;
+    int i, live, nfds, pending, eof = 0;
+
+    while (fds && !eof) {
+        live = 0;
+        nfds = 0;
+
+        /* Extend every target that is level with the head.  */
+        for (i = 0; i < pump->count; i++) {
+            pump_target *t = &pump->targets[i];
+            if (t->fd < 0) continue;
+            live++;
+            if (t->ahead > 0) continue;
+
+            n = tee(pump->source, t->fd, FANOUT_CHUNK, SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                if (t->file >= 0 && drain_to_file(t, n) < 0) {
+                    close_target(t);
+                    live--;
+                    continue;
+                }
+                t->ahead = n;
+            } else if (n == 0) {
+                eof = 1;
+                break;
+            } else if (errno == EAGAIN) {
+                fds[nfds].fd = t->fd;
+                fds[nfds].events = POLLOUT;
+                nfds++;
+            } else if (errno != EINTR) {
+                /* EPIPE: this consumer went away, keep feeding the rest */
+                close_target(t);
+                live--;
+            }
+        }
+        if (eof || live == 0) break;
+
+        min = (size_t) -1;
+        for (i = 0; i < pump->count; i++) {
+            if (pump->targets[i].fd >= 0 && pump->targets[i].ahead < min) {
+                min = pump->targets[i].ahead;
+            }
+        }
+        if (min > 0) {
+            if (consume(pump, min) < 0) break;
+            for (i = 0; i < pump->count; i++) {
+                pump->targets[i].ahead -= min;
+            }
+            continue;
+        }
+
+        /* Nothing moved: wait for data, or for room in a lagging
+           target if the source already has data for it.  */
+        if (ioctl(pump->source, FIONREAD, &pending) < 0 || pending == 0) {
+            fds[0].fd = pump->source;
+            fds[0].events = POLLIN;
+            nfds = 1;
+        }
+        if (nfds > 0 && poll(fds, nfds, -1) < 0 && errno != EINTR) break;
+    }
+
+    /* Closing the source makes a producer still writing get EPIPE. */
+    close(pump->source);
+    close(pump->devnull);
+    for (i = 0; i < pump->count; i++) {
+        close_target(&pump->targets[i]);
+    }
+    free(fds);
+    free(pump->targets);
+    free(pump);
+    return NULL;
+}
+
+/* Start a detached thread that copies everything written into the pipe
+   whose read end is source to every fd in targets.  Targets may be
+   pipes or regular files.  The pump takes ownership of all the fds,
+   closing the targets once the source reaches EOF.  */
+int fanout_pump_start(int source, int *targets, int count) {
+    fanout_pump *pump = malloc(sizeof(fanout_pump));
+    pthread_attr_t attr;
+    pthread_t thread;
+    sigset_t block, saved;
+    struct stat st;
+    int i, file_pipe[2], error;
+
+    if (!pump) return -1;
+    pump->source = source;
+    pump->count = count;
+    pump->devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    pump->targets = calloc(count, sizeof(pump_target));
+    if (pump->devnull < 0 || !pump->targets) {
+        free(pump->targets);
+        free(pump);
+        return -1;
+    }
+
+    fcntl(source, F_SETPIPE_SZ, FANOUT_PIPE_SIZE);
+    for (i = 0; i < count; i++) {
+        pump_target *t = &pump->targets[i];
+        t->fd = targets[i];
+        t->file = -1;
+        t->file_pipe = -1;
+
+        if (fstat(targets[i], &st) == 0 && !S_ISFIFO(st.st_mode)) {
+            if (pipe2(file_pipe, O_CLOEXEC) < 0) {
+                perror("pipe");
+                t->fd = -1;
+                close(targets[i]);
+                continue;
+            }
+            t->file = targets[i];
+            t->file_pipe = file_pipe[0];
+            t->fd = file_pipe[1];
+        }
+        fcntl(t->fd, F_SETPIPE_SZ, FANOUT_PIPE_SIZE);
+    }
+
+    /* A consumer exiting early must not SIGPIPE the whole shell; the
+       pump thread inherits this mask and sees EPIPE instead.  It takes
+       no other signal either, so SIGCHLD and SIGINT stay pending for
+       the shell's waits.  */
+    sigfillset(&block);
+    pthread_sigmask(SIG_BLOCK, &block, &saved);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    error = pthread_create(&thread, &attr, run_pump, pump);
+    pthread_attr_destroy(&attr);
+
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (error) {
+        fprintf(stderr, "minishell: pthread_create: %s\n", strerror(error));
+        close(pump->devnull);
+        for (i = 0; i < count; i++) {
+            close_target(&pump->targets[i]);
+        }
+        free(pump->targets);
+        free(pump);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,11 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include <stddef.h>
+
+#define FANOUT_CHUNK (1 << 20)
+#define FANOUT_PIPE_SIZE (1 << 20)
+
+int fanout_pump_start(int source, int *targets, int count);
+
+#endif
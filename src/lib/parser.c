@@ -35,13 +35,14 @@ char *readline() {
 
 char *strtrim(char *line) {
     char *head = line;
-    char *tail = line + strlen(line);
+    char *tail;
 
-    while (*head == ' ') head++;
+    while (*head == ' ' || *head == '\t') head++;
 
-    while (*tail == ' ') tail++;
+    tail = head + strlen(head);
+    while (tail > head && (tail[-1] == ' ' || tail[-1] == '\t' || tail[-1] == '\n')) tail--;
 
-    *(tail + 1) = '\0';
+    *tail = '\0';
 
     return head;
 }
@@ -59,9 +60,9 @@ job* parse_line(char *line) {
 
     int seg_len = 0, mode = FOREGROUND_EXECUTION;
 
-    if (line[strlen(line) - 1] == '&') {
+    if (*line && line[strlen(line) - 1] == '&') {
         mode = BACKGROUND_EXECUTION;
-        line[strlen(line) -1] == '\0';
+        line[strlen(line) - 1] = '\0';
     }
 
     while (true) {
@@ -71,6 +72,7 @@ job* parse_line(char *line) {
             seg[seg_len] = '\0';
 
             process *new_proc = (process *) parse_command_segment(seg);
+            free(seg);
             if (!root_proc) {
                 root_proc = new_proc;
                 proc = root_proc;
@@ -94,15 +96,47 @@ job* parse_line(char *line) {
         }
     }
 
-    job *new_job = (job *) malloc(sizeof(job));
-    new_job->root_process = root_proc;
-    new_job->command = command;
-    new_job->mode = mode;
-    new_job->pgid = -1;
-    new_job->stdin = STDIN_FILENO;
-    new_job->stdout = STDOUT_FILENO;
-    new_job->stderr = STDERR_FILENO;
-    return new_job;
+    return new_job(command, root_proc, mode);
+}
+
+job *new_job(char *command, process *root_process, int mode) {
+    job *j = (job *) malloc(sizeof(job));
+
+    if (!j) {
+        fprintf(stderr, "minishell: malloc error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    j->root_process = root_process;
+    j->command = command;
+    j->mode = mode;
+    j->pgid = 0;
+    j->stdin = STDIN_FILENO;
+    j->stdout = STDOUT_FILENO;
+    j->stderr = STDERR_FILENO;
+    j->notified = 0;
+    j->timeout_ms = -1;
+    j->kill_after_ms = -1;
+    j->timed_out = 0;
+    j->submitted = 0;
+    j->queued = 0;
+    j->queue_id = 0;
+    memset(&j->start_time, 0, sizeof(j->start_time));
+    memset(&j->launched_time, 0, sizeof(j->launched_time));
+    memset(&j->end_time, 0, sizeof(j->end_time));
+    j->next = NULL;
+    return j;
+}
+
+/* The last stage of the pipeline, whose status is the job's.  Fan-out
+   consumers are appended after it and are skipped.  */
+process *job_last_stage(job *j) {
+    process *p, *last = j->root_process;
+
+    for (p = j->root_process; p; p = p->next) {
+        if (!p->consumer) last = p;
+    }
+    return last;
 }
 
 int get_command_type(char *command) {
@@ -114,13 +148,60 @@ int get_command_type(char *command) {
     else if (strcmp(command, "fg") == 0) return COMMAND_FG;
     else if (strcmp(command, "bg") == 0) return COMMAND_BG;
     else if (strcmp(command, "kill") == 0) return COMMAND_KILL;
+    else if (strcmp(command, "wait") == 0) return COMMAND_WAIT;
+    else if (strcmp(command, "timeout") == 0) return COMMAND_TIMEOUT;
+    else if (strcmp(command, "batch") == 0) return COMMAND_BATCH;
     else return COMMAND_EXTERNAL;
 }
 
+static fanout_target *new_fanout_target(char *command, char *path) {
+    fanout_target *target = (fanout_target *) malloc(sizeof(fanout_target));
+
+    if (!target) {
+        fprintf(stderr, "minishell: allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    target->command = command;
+    target->path = path;
+    target->next = NULL;
+    return target;
+}
+
+static void append_fanout_target(fanout_target **list, fanout_target *target) {
+    while (*list) list = &(*list)->next;
+    *list = target;
+}
+
+/* Pull every >(command) out of segment, blanking it so the tokenizer
+   never sees it.  */
+static fanout_target *extract_fanout_commands(char *segment) {
+    fanout_target *list = NULL;
+    char *start, *end;
+    int depth;
+
+    while ((start = strstr(segment, ">(")) != NULL) {
+        depth = 1;
+        for (end = start + 2; *end && depth > 0; end++) {
+            if (*end == '(') depth++;
+            else if (*end == ')') depth--;
+        }
+        if (depth > 0) {
+            fprintf(stderr, "minishell: missing ')' in %s\n", start);
+            break;
+        }
+
+        /* end is one past the closing parenthesis */
+        append_fanout_target(&list, new_fanout_target(strndup(start + 2, end - start - 3), NULL));
+        memset(start, ' ', end - start);
+    }
+    return list;
+}
+
 process *parse_command_segment(char *segment) {
     int bufsize = TOKEN_BUFSIZE;
-    int position = 0;
+    int position = 0, expanded_start = -1, expanded_end = -1;
     char *command = strdup(segment);
+    fanout_target *fanout = extract_fanout_commands(segment);
     char *token;
     char **tokens = (char**) malloc(bufsize * sizeof(char*));
 
@@ -150,12 +231,14 @@ process *parse_command_segment(char *segment) {
 
         if (glob_count > 0) {
             int i;
+            if (expanded_start < 0) expanded_start = position;
+            expanded_end = position + glob_count;
             for (i = 0; i < glob_count; i++) {
                 tokens[position++] = strdup(glob_buffer.gl_pathv[i]);
             }
             globfree(&glob_buffer);
         } else {
-            tokens[position] = token;
+            tokens[position] = strdup(token);
             position++;
         }
 
@@ -184,6 +267,10 @@ process *parse_command_segment(char *segment) {
                 strcpy(input_path, tokens[i] + 1);
             }
         } else if (tokens[i][0] == '>') {
+            /* every output past the first becomes a fan-out target */
+            if (output_path) {
+                append_fanout_target(&fanout, new_fanout_target(NULL, output_path));
+            }
             if (strlen(tokens[i]) == 1) {
                 output_path = (char *) malloc((strlen(tokens[i + 1]) + 1) * sizeof(char));
                 strcpy(output_path, tokens[i + 1]);
@@ -198,16 +285,55 @@ process *parse_command_segment(char *segment) {
     }
 
     for (i = argc; i <= position; i++) {
+        if (i < position) free(tokens[i]);
         tokens[i] = NULL;
     }
 
+    /* with fan-out, the file joins the other destinations */
+    if (fanout && output_path) {
+        append_fanout_target(&fanout, new_fanout_target(NULL, output_path));
+        output_path = NULL;
+    }
+
+    process *new_process = new_process_from_argv(command, argc, tokens);
+    new_process->input_path = input_path;
+    new_process->output_path = output_path;
+    new_process->fanout = fanout;
+
+    /* expanded words past the redirections are not arguments */
+    if (expanded_start >= 0 && expanded_start < argc) {
+        new_process->expanded_start = expanded_start;
+        new_process->expanded_end = expanded_end < argc ? expanded_end : argc;
+    }
+    return new_process;
+}
+
+/* A process for argv (NULL-terminated, argc entries), taking ownership
+   of command and argv.  */
+process *new_process_from_argv(char *command, int argc, char **argv) {
     process *new_process = (process *) malloc(sizeof(process));
+
+    if (!new_process) {
+        fprintf(stderr, "minishell: malloc error\n");
+        exit(EXIT_FAILURE);
+    }
+
     new_process->argc = argc;
-    new_process->argv = tokens;
+    new_process->argv = argv;
     new_process->command = command;
-    new_process->input_path = input_path;
-    new_process->output_path = output_path;
+    new_process->input_path = NULL;
+    new_process->output_path = NULL;
+    new_process->fanout = NULL;
+    new_process->expanded_start = -1;
+    new_process->expanded_end = -1;
     new_process->pid = -1;
-    new_process->command_type = get_command_type(tokens[0]);
+    new_process->status = 0;
+    memset(&new_process->usage, 0, sizeof(new_process->usage));
+    new_process->completed = 0;
+    new_process->stopped = 0;
+    new_process->threaded = 0;
+    new_process->consumer = 0;
+    new_process->next = NULL;
+    new_process->command_type = argc > 0 ? get_command_type(argv[0]) : COMMAND_EXTERNAL;
     return new_process;
 }
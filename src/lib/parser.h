@@ -8,6 +8,7 @@
 #include <pwd.h>
 #include <stdbool.h>
 #include <glob.h>
+#include <time.h>
 #include "process.h"
 
 #define TOKEN_BUFSIZE 64
@@ -23,6 +24,9 @@
 #define COMMAND_FG 6
 #define COMMAND_BG 7
 #define COMMAND_KILL 8
+#define COMMAND_WAIT 9
+#define COMMAND_TIMEOUT 10
+#define COMMAND_BATCH 11
 
 typedef struct job {
     char *command;
@@ -31,6 +35,12 @@ typedef struct job {
     pid_t pgid;
     struct termios tmodes;
     char notified;
+    struct timespec start_time, launched_time, end_time;
+    int timeout_ms, kill_after_ms;  /* -1 waits without a deadline */
+    char timed_out;
+    char submitted;         /* read from the user, not started by a builtin */
+    char queued;            /* held back by admission control */
+    int queue_id;           /* qN while queued, 0 if never queued */
     int stdin, stdout, stderr;
     struct job *next;
 } job;
@@ -44,5 +54,8 @@ char *readline();
 job *parse_line(char *line);
 char *strtrim(char *line);
 process *parse_command_segment(char *segment);
+process *new_process_from_argv(char *command, int argc, char **argv);
+job *new_job(char *command, process *root_process, int mode);
+process *job_last_stage(job *j);
 
 #endif
\ No newline at end of file
@@ -6,7 +6,9 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <sys/signal.h>
+#include <pthread.h>
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -20,15 +22,28 @@
 #define STATUS_CONTINUED 3
 #define STATUS_TERMINATED 4
 
+/* one destination of a fan-out redirection: >(command) or > path */
+typedef struct fanout_target {
+    char *command;
+    char *path;
+    struct fanout_target *next;
+} fanout_target;
+
 typedef struct process {
     char *command;
     int argc;
     char **argv;
     char *input_path;
     char *output_path;
+    fanout_target *fanout;
+    int expanded_start, expanded_end;   /* argv range produced by globbing */
     pid_t pid;
     int command_type;
     int status;
+    struct rusage usage;
+    pthread_t thread;       /* builtin stage running inside the shell */
+    char threaded;
+    char consumer;          /* reads a >(...) fan-out, not a pipeline stage */
     struct process *next;
     char completed, stopped;
 } process;
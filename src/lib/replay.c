@@ -0,0 +1,173 @@
+#include "replay.h"
+
+/*
+Replays a session recorded with --record through parse_line and
+launch_job, then reports throughput, per-phase latency percentiles and
+the commands whose exit code differs from the recording.
+
+    parse   parse_line
+    launch  launch_job until every process has been started
+    reap    from then until the last process was reaped
+*/
+
+static long long now_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long long timespec_diff_ns(struct timespec *end, struct timespec *start) {
+    return (long long) (end->tv_sec - start->tv_sec) * 1000000000 + (end->tv_nsec - start->tv_nsec);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const replay_entry *x = a, *y = b;
+    return (x->offset_ns > y->offset_ns) - (x->offset_ns < y->offset_ns);
+}
+
+static int compare_ll(const void *a, const void *b) {
+    const long long *x = a, *y = b;
+    return (*x > *y) - (*x < *y);
+}
+
+static replay_entry *load_recording(const char *path, int *count) {
+    FILE *file = fopen(path, "r");
+    replay_entry *entries = NULL;
+    int size = 0, n = 0;
+    char *line = NULL, *command;
+    size_t capacity = 0;
+    ssize_t length;
+    long long offset;
+    int code, consumed;
+
+    if (!file) {
+        fprintf(stderr, "minishell: %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    while ((length = getline(&line, &capacity, file)) >= 0) {
+        if (length > 0 && line[length - 1] == '\n') line[--length] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+
+        if (sscanf(line, "%lld\t%d\t%n", &offset, &code, &consumed) != 2) {
+            fprintf(stderr, "minishell: %s: bad record: %s\n", path, line);
+            continue;
+        }
+        command = line + consumed;
+        if (*command == '\0') continue;
+
+        if (n == size) {
+            size = size ? size * 2 : 64;
+            entries = (replay_entry *) realloc(entries, size * sizeof(replay_entry));
+            if (!entries) {
+                fprintf(stderr, "minishell: malloc error\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        entries[n].offset_ns = offset;
+        entries[n].exit_code = code;
+        entries[n].command = strdup(command);
+        n++;
+    }
+    free(line);
+    fclose(file);
+
+    /* jobs are recorded as they finish, replay them as they started */
+    qsort(entries, n, sizeof(replay_entry), compare_entries);
+    *count = n;
+    return entries ? entries : (replay_entry *) malloc(sizeof(replay_entry));
+}
+
+static void print_percentiles(const char *phase, long long *samples, int n) {
+    qsort(samples, n, sizeof(long long), compare_ll);
+#define PCT(p) (samples[(n - 1) * (p) / 100] / 1000.0)
+    fprintf(stderr, "%-7s p50 %10.1fus  p90 %10.1fus  p99 %10.1fus  max %10.1fus\n",
+            phase, PCT(50), PCT(90), PCT(99), samples[n - 1] / 1000.0);
+#undef PCT
+}
+
+/* Run every recorded command, either at its recorded offset or back to
+   back when fast is set.  Returns the number of divergences, or -1 if
+   the recording could not be read.  */
+int replay_session(shell_info *shell, const char *path, bool fast) {
+    replay_entry *entries;
+    long long *parse, *launch, *reap;
+    long long start, wall, wait_ns;
+    int count, i, code, divergences = 0;
+    struct timespec delay;
+    char *line;
+    job *j;
+
+    entries = load_recording(path, &count);
+    if (!entries) return -1;
+    if (count == 0) {
+        fprintf(stderr, "minishell: %s: nothing to replay\n", path);
+        free(entries);
+        return 0;
+    }
+
+    parse = (long long *) malloc(count * sizeof(long long));
+    launch = (long long *) malloc(count * sizeof(long long));
+    reap = (long long *) malloc(count * sizeof(long long));
+    if (!parse || !launch || !reap) {
+        fprintf(stderr, "minishell: malloc error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    start = now_ns(CLOCK_MONOTONIC);
+    for (i = 0; i < count; i++) {
+        if (!fast) {
+            wait_ns = entries[i].offset_ns - (now_ns(CLOCK_MONOTONIC) - start);
+            if (wait_ns > 0) {
+                delay.tv_sec = wait_ns / 1000000000;
+                delay.tv_nsec = wait_ns % 1000000000;
+                while (nanosleep(&delay, &delay) < 0 && errno == EINTR);
+            }
+        }
+
+        /* parse_line trims in place and keeps its own copy */
+        line = strdup(entries[i].command);
+        parse[i] = now_ns(CLOCK_MONOTONIC);
+        j = parse_line(line);
+        parse[i] = now_ns(CLOCK_MONOTONIC) - parse[i];
+        free(line);
+
+        j->submitted = 1;
+        j->next = shell->root_job;
+        shell->root_job = j;
+
+        /* without a terminal launch_job waits for every job */
+        launch_job(j, shell);
+        launch[i] = timespec_diff_ns(&j->launched_time, &j->start_time);
+        reap[i] = timespec_diff_ns(&j->end_time, &j->launched_time);
+        if (reap[i] < 0) reap[i] = 0;
+
+        code = job_exit_code(j);
+        if (code != entries[i].exit_code) {
+            if (divergences < REPLAY_MAX_DIVERGENCES_SHOWN) {
+                fprintf(stderr, "divergence: #%d exit %d, recorded %d: %s\n",
+                        i + 1, code, entries[i].exit_code, entries[i].command);
+            }
+            divergences++;
+        }
+
+        do_job_notification(shell);
+    }
+    wall = now_ns(CLOCK_MONOTONIC) - start;
+
+    fprintf(stderr, "replayed %d commands in %.3fs, %.1f commands/sec%s\n",
+            count, wall / 1e9, count / (wall / 1e9), fast ? " (fast)" : "");
+    print_percentiles("parse", parse, count);
+    print_percentiles("launch", launch, count);
+    print_percentiles("reap", reap, count);
+    fprintf(stderr, "%d of %d exit codes diverged from the recording\n", divergences, count);
+
+    for (i = 0; i < count; i++) {
+        free(entries[i].command);
+    }
+    free(entries);
+    free(parse);
+    free(launch);
+    free(reap);
+    return divergences;
+}
@@ -0,0 +1,16 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "shell.h"
+
+#define REPLAY_MAX_DIVERGENCES_SHOWN 10
+
+typedef struct replay_entry {
+    long long offset_ns;
+    int exit_code;
+    char *command;
+} replay_entry;
+
+int replay_session(shell_info *shell, const char *path, bool fast);
+
+#endif
@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+
+#include "server.h"
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *cursor = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        n = read(fd, cursor, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        cursor += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int send_response(int client, server_response *response) {
+    if (send(client, response, sizeof(*response), MSG_NOSIGNAL) != sizeof(*response)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int send_fds(int client, int out, int err) {
+    char byte = 0;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg;
+    int fds[2] = { out, err };
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return sendmsg(client, &msg, MSG_NOSIGNAL) == 1 ? 0 : -1;
+}
+
+/* Runs in a forked worker: read one request, run it as a job and
+   report how it went.  The worker's only children are the job's
+   processes, so RUSAGE_CHILDREN is exactly the job's usage.  */
+static void handle_client(int client, shell_info *shell) {
+    server_request request;
+    server_response response = { 0 };
+    int out[2] = { -1, -1 }, err[2] = { -1, -1 };
+    process *p;
+    job *j;
+    char *line;
+    int status;
+
+    if (read_full(client, &request, sizeof(request)) < 0) return;
+
+    if (request.length == 0 || request.length > SERVER_MAX_COMMAND) {
+        response.error = SERVER_BAD_REQUEST;
+        send_response(client, &response);
+        return;
+    }
+
+    line = (char *) malloc(request.length + 1);
+    if (!line || read_full(client, line, request.length) < 0) return;
+    line[request.length] = '\0';
+
+    if (request.flags & SERVER_CAPTURE_OUTPUT) {
+        if (pipe2(out, O_CLOEXEC) < 0 || pipe2(err, O_CLOEXEC) < 0) {
+            perror("pipe");
+            response.error = SERVER_INTERNAL_ERROR;
+            send_response(client, &response);
+            return;
+        }
+        if (send_fds(client, out[0], err[0]) < 0) return;
+        close(out[0]);
+        close(err[0]);
+    }
+
+    j = parse_line(line);
+    free(line);
+    j->stdin = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (request.flags & SERVER_CAPTURE_OUTPUT) {
+        j->stdout = out[1];
+        j->stderr = err[1];
+    }
+    j->next = shell->root_job;
+    shell->root_job = j;
+
+    status = launch_job(j, shell);
+
+    if (j->stdin >= 0) close(j->stdin);
+    if (request.flags & SERVER_CAPTURE_OUTPUT) {
+        close(out[1]);
+        close(err[1]);
+    }
+
+    p = job_last_stage(j);
+    if (p->pid > 0) response.status = p->status;
+    else response.status = (status & 0xff) << 8;
+
+    if (shell->audit) audit_job(shell->audit, j);
+
+    getrusage(RUSAGE_CHILDREN, &response.usage);
+    send_response(client, &response);
+}
+
+int shell_server(shell_info *shell, const char *path, int max_jobs) {
+    struct sockaddr_un addr = { 0 };
+    int sock, client, active = 0;
+    pid_t pid;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "minishell: %s: socket path too long\n", path);
+        return -1;
+    }
+    if (max_jobs < 1) max_jobs = 1;
+
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+            listen(sock, SERVER_BACKLOG) < 0) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+
+    while (true) {
+        /* Reap finished workers, blocking while we are at the limit.  */
+        while (active > 0) {
+            pid = waitpid(-1, NULL, active >= max_jobs ? 0 : WNOHANG);
+            if (pid <= 0) break;
+            active--;
+        }
+
+        client = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
+        }
+
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            close(client);
+        } else if (pid == 0) {
+            /* worker */
+            close(sock);
+            handle_client(client, shell);
+            exit(EXIT_SUCCESS);
+        } else {
+            active++;
+            close(client);
+        }
+    }
+
+    close(sock);
+    unlink(path);
+    return -1;
+}
@@ -0,0 +1,45 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "shell.h"
+
+#define SERVER_BACKLOG 64
+#define SERVER_DEFAULT_MAX_JOBS 16
+#define SERVER_MAX_COMMAND 65536
+
+/* request flags */
+#define SERVER_CAPTURE_OUTPUT 0x1
+
+/* response errors */
+#define SERVER_OK 0
+#define SERVER_BAD_REQUEST 1
+#define SERVER_INTERNAL_ERROR 2
+
+/*
+Wire protocol, one request per connection:
+
+    client -> server: server_request, then `length` bytes of command line
+    server -> client: if SERVER_CAPTURE_OUTPUT was set, one byte carrying
+                      the read ends of the job's stdout and stderr pipes
+                      as SCM_RIGHTS ancillary data
+    server -> client: server_response once the job has finished
+*/
+typedef struct server_request {
+    uint32_t flags;
+    uint32_t length;
+} server_request;
+
+typedef struct server_response {
+    int32_t error;
+    int32_t status;         /* wait(2) style status of the last process */
+    struct rusage usage;    /* resources used by all processes of the job */
+} server_response;
+
+int shell_server(shell_info *shell, const char *path, int max_jobs);
+
+#endif
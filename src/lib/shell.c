@@ -1,19 +1,46 @@
-#include "shell.h"
+#define _GNU_SOURCE
 
-shell_info *init_shell() {
-    pid_t pid = getpid();
-    setpgid(pid, pid);
-    tcsetpgrp(0, pid);
+#include "shell.h"
 
+static shell_info *alloc_shell_info() {
     shell_info *shell = (shell_info *) malloc(sizeof(shell_info));
 
+    if (!shell) {
+        fprintf(stderr, "minishell: malloc error\n");
+        exit(EXIT_FAILURE);
+    }
+
     getlogin_r(shell->cur_user, sizeof(shell->cur_user));
     struct passwd *pw = getpwuid(getuid());
     strcpy(shell->pw_dir, pw->pw_dir);
     update_cwd_info(shell);
     shell->root_job = NULL;
-
     shell->shell_terminal = STDIN_FILENO;
+    shell->shell_pgid = getpgrp();
+    shell->spawn_helper = -1;
+    shell->audit = NULL;
+    shell->record = NULL;
+    admission_limits_init(&shell->admission);
+    shell->next_queue_id = 1;
+    return shell;
+}
+
+/* A shell without job control, for modes that never own a terminal
+   (e.g. the command server).  Jobs are always waited for and signal
+   dispositions are left untouched.  */
+shell_info *init_noninteractive_shell() {
+    shell_info *shell = alloc_shell_info();
+    shell->is_interactive = 0;
+    return shell;
+}
+
+shell_info *init_shell() {
+    pid_t pid = getpid();
+    setpgid(pid, pid);
+    tcsetpgrp(0, pid);
+
+    shell_info *shell = alloc_shell_info();
+
     shell->is_interactive = isatty(shell->shell_terminal);
     if (shell->is_interactive) {
         while (tcgetpgrp (shell->shell_terminal) != (shell->shell_pgid = getpgrp ()))
@@ -24,7 +51,6 @@ shell_info *init_shell() {
         signal (SIGTSTP, SIG_IGN);
         signal (SIGTTIN, SIG_IGN);
         signal (SIGTTOU, SIG_IGN);
-        signal (SIGCHLD, SIG_IGN);
 
         shell->shell_pgid = getpid();
         if (setpgid (shell->shell_pgid, shell->shell_pgid) < 0) {
@@ -43,8 +69,6 @@ shell_info *init_shell() {
 }
 
 int launch_process(process *p, int infile, int outfile, job* j, shell_info* shell) {
-    if (p->command_type != COMMAND_EXTERNAL && launch_builtin_command(p, shell)) return 0;
-
     pid_t pid;
 
     if (shell->is_interactive) {
@@ -69,6 +93,11 @@ int launch_process(process *p, int infile, int outfile, job* j, shell_info* shel
         signal (SIGCHLD, SIG_DFL);
     }
     
+    if (j->stderr != STDERR_FILENO) {
+        dup2(j->stderr, 2);
+        if (j->stderr != outfile) close(j->stderr);
+    }
+
     if (infile != STDIN_FILENO) {
         dup2(infile, 0);
         close(infile);
@@ -79,23 +108,80 @@ int launch_process(process *p, int infile, int outfile, job* j, shell_info* shel
         close(outfile);
     }
 
+    if (p->command_type != COMMAND_EXTERNAL) {
+        /* a builtin stage of a pipeline runs in this subshell */
+        exit(launch_builtin_command(p, shell));
+    }
+
     if (execv(p->argv[0], p->argv) < 0) {
+        if (errno == E2BIG) {
+            fprintf(stderr, "minishell: %s: argument list too long (see batch)\n", p->argv[0]);
+            exit(126);
+        } else if (errno != ENOENT) {
+            fprintf(stderr, "minishell: %s: %s\n", p->argv[0], strerror(errno));
+            exit(126);
+        }
         printf("minishell: %s: command not found\n", p->argv[0]);
         exit(0);
     }
 
 }
 
+static void fformat_job_info(FILE *out, job *j, const char *status) {
+	/* jobs still queued, or dropped from the queue, have no process group */
+	if (!j->pgid && j->queue_id) fprintf(out, "q%d (%s): %s\n", j->queue_id, status, j->command);
+	else fprintf(out, "%ld (%s): %s\n", (long)j->pgid, status, j->command);
+}
+
+/* Start recording the session to path, for later --replay.  */
+int record_open(shell_info *shell, const char *path) {
+    shell->record = fopen(path, "we");
+    if (!shell->record) {
+        fprintf(stderr, "minishell: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fprintf(shell->record, "%s\n", RECORD_HEADER);
+    /* flush before the first fork or children write the header again */
+    fflush(shell->record);
+    clock_gettime(CLOCK_REALTIME, &shell->record_start);
+    return 0;
+}
+
+/* Append a finished job to the session recording:
+   submission offset in ns, exit code, command line.  */
+static void record_job(job *j, shell_info *shell) {
+    long long offset = (long long) (j->start_time.tv_sec - shell->record_start.tv_sec) * 1000000000 +
+        (j->start_time.tv_nsec - shell->record_start.tv_nsec);
+
+    fprintf(shell->record, "%lld\t%d\t%s\n", offset, job_exit_code(j), j->command);
+    fflush(shell->record);
+}
+
 void format_job_info(job *j, const char *status) {
-	fprintf(stderr, "%ld (%s): %s\n", (long)j->pgid, status, j->command);
+	fformat_job_info(stderr, j, status);
+}
+
+void free_fanout(fanout_target *target) {
+    fanout_target *next;
+    for (; target; target = next) {
+        next = target->next;
+        free(target->command);
+        free(target->path);
+        free(target);
+    }
 }
 
 void free_process(process *p) {
     int i;
+    if (p->threaded) pthread_join(p->thread, NULL);
     for (i = 0; p->argv[i]; ++i) {
         free(p->argv[i]);
     }
     free(p->argv);
+    free(p->command);
+    free(p->input_path);
+    free(p->output_path);
+    free_fanout(p->fanout);
     free(p);
 }
 
@@ -118,25 +204,86 @@ job *find_job_by_pgid(pid_t pgid, shell_info *shell) {
     return NULL;
 }
 
+/* completed is also written by threads running builtin stages */
+static bool process_is_completed(process *p) {
+    return __atomic_load_n(&p->completed, __ATOMIC_ACQUIRE);
+}
+
+static void mark_process_completed(process *p) {
+    __atomic_store_n(&p->completed, 1, __ATOMIC_RELEASE);
+}
+
+/* Forget the stops of a job that has just been sent SIGCONT.  */
+static void mark_job_continued(job *j) {
+    process *p;
+
+    for (p = j->root_process; p; p = p->next) p->stopped = 0;
+    j->notified = 0;
+}
+
+/* Resolve a job argument: a pgid, optionally written %pgid, or qN for
+   a job queued by admission control, before or after it started.  */
+static job *find_job_by_spec(const char *spec, shell_info *shell) {
+    job *j;
+    int id;
+
+    if (*spec == '%') spec++;
+    if (*spec == 'q') {
+        id = atoi(spec + 1);
+        for (j = shell->root_job; j; j = j->next) {
+            if (id > 0 && j->queue_id == id) return j;
+        }
+        return NULL;
+    }
+    id = atoi(spec);
+    return id > 0 ? find_job_by_pgid(id, shell) : NULL;
+}
+
+/* A builtin thread cannot be stopped, but once its partners are, it
+   just waits on them: the job counts as stopped.  */
 bool job_is_stopped(job *j) {
     process *p;
+    bool stopped = false, threads = false;
 
     for (p = j->root_process; p; p = p->next) {
-        if (!p->completed && !p->stopped) return false;
+        if (p->stopped) stopped = true;
+        else if (process_is_completed(p)) continue;
+        else if (p->threaded) threads = true;
+        else return false;
+    }
+    return stopped || !threads;
+}
+
+static bool job_has_live_children(job *j) {
+    process *p;
+
+    for (p = j->root_process; p; p = p->next) {
+        if (p->pid > 0 && !process_is_completed(p) && !p->stopped) return true;
+    }
+    return false;
+}
+
+static void join_builtin_threads(job *j) {
+    process *p;
+
+    for (p = j->root_process; p; p = p->next) {
+        if (p->threaded) {
+            pthread_join(p->thread, NULL);
+            p->threaded = 0;
+        }
     }
-    return true;
 }
 
 bool job_is_completed(job *j) {
     process *p;
 
     for (p = j->root_process; p; p = p->next) {
-        if (!p->completed) return false;
+        if (!process_is_completed(p)) return false;
     }
     return true;
 }
 
-int mark_process_status(pid_t pid, int status, shell_info *shell) {
+int mark_process_status(pid_t pid, int status, struct rusage *usage, shell_info *shell) {
 	job *j;
 	process *p;
 
@@ -149,7 +296,9 @@ int mark_process_status(pid_t pid, int status, shell_info *shell) {
 					if (WIFSTOPPED(status)) {
 						p->stopped = 1;
 					} else {
-						p->completed = 1;
+						p->usage = *usage;
+						clock_gettime(CLOCK_REALTIME, &j->end_time);
+						mark_process_completed(p);
 						if (WIFSIGNALED(status)) {
 							fprintf(stderr, "%d: Terminated by signal %d.\n",
 									(int)pid, WTERMSIG(p->status));
@@ -171,29 +320,226 @@ int mark_process_status(pid_t pid, int status, shell_info *shell) {
 	}
 }
 
-void print_job_info(job *j) {
-    if (job_is_completed(j)) format_job_info(j, "completed");
-    else if (job_is_stopped(j)) format_job_info(j, "stopped");
-    else format_job_info(j, "running");
+void print_job_info(job *j, FILE *out) {
+    if (j->queued) fformat_job_info(out, j, "queued");
+    else if (job_is_completed(j)) fformat_job_info(out, j, "completed");
+    else if (job_is_stopped(j)) fformat_job_info(out, j, "stopped");
+    else fformat_job_info(out, j, "running");
+}
+
+static long elapsed_ms(struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/* Signals that end a wait early.  SIGCHLD reports stops, which a pidfd
+   does not.  An interactive shell ignores SIGINT, but blocked it stays
+   pending, so Ctrl-C can still break out of wait.  */
+static void wait_signal_mask(sigset_t *mask, bool children, shell_info *shell) {
+    sigemptyset(mask);
+    if (children) sigaddset(mask, SIGCHLD);
+    if (shell->is_interactive) sigaddset(mask, SIGINT);
+}
+
+static int open_wait_signals(sigset_t *mask, sigset_t *saved) {
+    int fd;
+
+    pthread_sigmask(SIG_BLOCK, mask, saved);
+    fd = signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        perror("signalfd");
+        pthread_sigmask(SIG_SETMASK, saved, NULL);
+    }
+    return fd;
+}
+
+static void close_wait_signals(int fd, sigset_t *saved) {
+    close(fd);
+    pthread_sigmask(SIG_SETMASK, saved, NULL);
+}
+
+/* Consume the pending signals; true if SIGINT was among them.  */
+static bool read_wait_signals(int fd) {
+    struct signalfd_siginfo info;
+    bool interrupted = false;
+
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGINT) interrupted = true;
+    }
+    return interrupted;
+}
+
+/* Block until every one of the jobs (or, with any, at least one of
+   them) has completed or stopped, or until timeout_ms has passed; -1
+   waits forever.  Each live process gets a pidfd so the poll wakes
+   exactly when one of ours exits, without reaping unrelated children;
+   stops arrive as SIGCHLD.  Returns 0 when the condition holds, 1 on
+   timeout, 2 if interrupted by SIGINT and -1 on error.  */
+static int wait_for_jobs_pidfd(job **jobs, int count, bool any, int timeout_ms, shell_info *shell) {
+    struct pollfd *fds = NULL;
+    process **procs = NULL, *p;
+    struct timespec start;
+    struct rusage usage;
+    sigset_t mask, saved;
+    int nfds = 1, size = 8, i, k, done, status, remaining, result = -1, sigfd;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    wait_signal_mask(&mask, true, shell);
+    sigfd = open_wait_signals(&mask, &saved);
+    if (sigfd < 0) return -1;
+
+    /* slot 0 is the signalfd */
+    fds = malloc(size * sizeof(struct pollfd));
+    procs = malloc(size * sizeof(process *));
+    if (!fds || !procs) {
+        fprintf(stderr, "minishell: malloc error\n");
+        exit(EXIT_FAILURE);
+    }
+    fds[0].fd = sigfd;
+    fds[0].events = POLLIN;
+    procs[0] = NULL;
+
+    for (i = 0; i < count; i++) {
+        for (p = jobs[i]->root_process; p; p = p->next) {
+            if (p->pid <= 0 || process_is_completed(p)) continue;
+            if (nfds == size) {
+                size *= 2;
+                fds = realloc(fds, size * sizeof(struct pollfd));
+                procs = realloc(procs, size * sizeof(process *));
+                if (!fds || !procs) {
+                    fprintf(stderr, "minishell: malloc error\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            fds[nfds].fd = syscall(SYS_pidfd_open, p->pid, 0);
+            fds[nfds].events = POLLIN;
+            if (fds[nfds].fd < 0) {
+                perror("pidfd_open");
+                goto out;
+            }
+            procs[nfds++] = p;
+        }
+    }
+
+    while (true) {
+        /* reap exits and stops of our processes */
+        for (i = 1, k = 1; i < nfds; i++) {
+            if (wait4(procs[i]->pid, &status, WNOHANG | WUNTRACED, &usage) > 0) {
+                mark_process_status(procs[i]->pid, status, &usage, shell);
+            }
+            if (process_is_completed(procs[i])) {
+                close(fds[i].fd);
+                continue;
+            }
+            fds[k] = fds[i];
+            procs[k++] = procs[i];
+        }
+        nfds = k;
+
+        done = 0;
+        for (i = 0; i < count; i++) {
+            if (job_is_completed(jobs[i]) || job_is_stopped(jobs[i])) done++;
+        }
+        if ((any && done > 0) || done == count) {
+            result = 0;
+            break;
+        }
+
+        remaining = -1;
+        if (timeout_ms >= 0) {
+            remaining = timeout_ms - elapsed_ms(&start);
+            if (remaining <= 0) {
+                result = 1;
+                break;
+            }
+        }
+
+        if (poll(fds, nfds, remaining) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        if (fds[0].revents && read_wait_signals(sigfd)) {
+            result = 2;
+            break;
+        }
+    }
+
+out:
+    for (i = 1; i < nfds; i++) {
+        close(fds[i].fd);
+    }
+    close_wait_signals(sigfd, &saved);
+    free(fds);
+    free(procs);
+    return result;
+}
+
+static void signal_job(job *j, int sig, shell_info *shell) {
+    process *p;
+
+    if (sig == SIGCONT) mark_job_continued(j);
+
+    if (shell->is_interactive && j->pgid > 0) {
+        kill(-j->pgid, sig);
+        return;
+    }
+    /* without job control the processes share the shell's group */
+    for (p = j->root_process; p; p = p->next) {
+        if (p->pid > 0 && !process_is_completed(p)) kill(p->pid, sig);
+    }
+}
+
+/* Wait for a job started by `timeout`: SIGTERM when the deadline
+   passes, SIGKILL if it is still around kill_after_ms later.  */
+static void wait_for_job_deadline(job *j, shell_info *shell) {
+    if (wait_for_jobs_pidfd(&j, 1, false, j->timeout_ms, shell) != 1) return;
+
+    j->timed_out = 1;
+    signal_job(j, SIGTERM, shell);
+    signal_job(j, SIGCONT, shell);
+
+    if (wait_for_jobs_pidfd(&j, 1, false, j->kill_after_ms, shell) != 1) return;
+
+    signal_job(j, SIGKILL, shell);
+    wait_for_jobs_pidfd(&j, 1, false, -1, shell);
 }
 
 void wait_for_job(struct job *j, shell_info *shell) {
+	struct rusage usage;
 	int status;
 	pid_t pid;
 
+	if (j->timeout_ms >= 0) {
+		wait_for_job_deadline(j, shell);
+		return;
+	}
+
 	do {
-		pid = waitpid(-1, &status, WUNTRACED);
-	} while (!mark_process_status(pid, status, shell) && !job_is_stopped(j) &&
+		/* Only builtin threads left: they finish once their pipe
+		   partners are gone, no child will report for them.  If the
+		   partners are only stopped, the threads wait on them, so
+		   report the stop instead of joining.  */
+		if (!job_has_live_children(j)) {
+			if (!job_is_stopped(j)) join_builtin_threads(j);
+			break;
+		}
+		pid = wait4(-1, &status, WUNTRACED, &usage);
+	} while (!mark_process_status(pid, status, &usage, shell) && !job_is_stopped(j) &&
 			!job_is_completed(j));
 }
 
 void update_status(shell_info *shell) {
+	struct rusage usage;
 	int status;
 	pid_t pid;
 
 	do {
-		pid = waitpid(-1, &status, WUNTRACED | WNOHANG);
-	} while (!mark_process_status(pid, status, shell));
+		pid = wait4(-1, &status, WUNTRACED | WNOHANG, &usage);
+	} while (!mark_process_status(pid, status, &usage, shell));
 }
 
 void do_job_notification(shell_info *shell) {
@@ -210,6 +556,8 @@ void do_job_notification(shell_info *shell) {
 		   completed and delete it from the list of active jobs.  */
 		if (job_is_completed(j)) {
 			format_job_info(j, "completed");
+			if (shell->audit) audit_job(shell->audit, j);
+			if (shell->record && j->submitted) record_job(j, shell);
 			if (jlast) {
 				jlast->next = jnext;
 			} else {
@@ -244,6 +592,7 @@ void put_job_in_foreground(struct job *j, int cont, shell_info *shell) {
 		if (kill(-j->pgid, SIGCONT) < 0) {
 			perror("kill (SIGCONT)");
 		}
+		mark_job_continued(j);
 	}
 
 	/* Wait for it to report.  */
@@ -265,6 +614,7 @@ void put_job_in_background(struct job *j, int cont) {
 		if (kill(-j->pgid, SIGCONT) < 0) {
 			perror("kill (SIGCONT)");
 		}
+		mark_job_continued(j);
 	}
 }
 
@@ -276,16 +626,311 @@ void shell_print_welcome() {
     printf("Minishell by gbrlbrbs.\n");
 }
 
-int launch_job(job *j, shell_info *shell) {
+/* Start p through the spawn helper instead of forking the shell.
+   Returns -1 if the helper is unusable, in which case it is shut
+   down and the caller falls back to fork.  */
+static pid_t spawn_job_process(process *p, int infile, int outfile, job *j, shell_info *shell) {
+    extern char **environ;
+    int fds[3] = { infile, outfile, j->stderr };
+    pid_t pid, pgid = SPAWN_NO_PGID;
+
+    if (shell->is_interactive) pgid = j->pgid;
+
+    pid = spawn_process(shell->spawn_helper, p->argv, environ, shell->cur_dir,
+                        fds, pgid, shell->is_interactive && j->mode);
+    if (pid == SPAWN_HELPER_LOST) {
+        /* the helper is gone for good, fork from now on */
+        perror("minishell: spawn helper");
+        close(shell->spawn_helper);
+        shell->spawn_helper = -1;
+    }
+    /* anything else, e.g. EAGAIN from clone, falls back to fork once */
+    return pid;
+}
+
+/* Fork (or spawn) p with the given stdin and stdout.  */
+static void start_process(process *p, int infile, int outfile, job *j, shell_info *shell) {
+    pid_t pid = -1;
+
+    if (shell->spawn_helper >= 0 && p->command_type == COMMAND_EXTERNAL) {
+        pid = spawn_job_process(p, infile, outfile, j, shell);
+    }
+
+    if (pid < 0) pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    } else if (pid == 0) {
+        /* child */
+        launch_process(p, infile, outfile, j, shell);
+    } else {
+        p->pid = pid;
+        if (shell->is_interactive) {
+            if (!j->pgid) j->pgid = pid;
+            setpgid(pid, j->pgid);
+        }
+    }
+}
+
+typedef struct builtin_stage {
     process *p;
+    shell_info *shell;
+    int infile;             /* pipe from the previous stage, or -1 */
+    int outfile;
+} builtin_stage;
+
+/* Read the previous stage's output to EOF, so that it can finish
+   writing instead of failing with EPIPE.  */
+static void drain_input(int fd) {
+    char buf[BUILTIN_DRAIN_SIZE];
+    ssize_t n;
+
+    do {
+        n = read(fd, buf, sizeof(buf));
+    } while (n > 0 || (n < 0 && errno == EINTR));
+}
+
+static void *run_builtin_stage(void *arg) {
+    builtin_stage *stage = arg;
+    FILE *out = fdopen(stage->outfile, "w");
+    int status = 1;
+
+    if (out) {
+        int fds[3] = { stage->infile, stage->outfile, STDERR_FILENO };
+        status = run_builtin_command(stage->p, stage->shell, out, fds);
+        fclose(out);
+    } else {
+        close(stage->outfile);
+    }
+
+    if (stage->infile >= 0) {
+        drain_input(stage->infile);
+        close(stage->infile);
+    }
+
+    stage->p->status = W_EXITCODE(status & 0xff, 0);
+    mark_process_completed(stage->p);
+    free(stage);
+    return NULL;
+}
+
+/* Builtins that only read shell state can run on a thread inside the
+   shell instead of a forked subshell.  The thread must be done before
+   the job list changes under it, so only jobs the shell waits for
+   qualify.  */
+static bool builtin_runs_on_thread(process *p, job *j, shell_info *shell) {
+    if (j->mode != FOREGROUND_EXECUTION && shell->is_interactive) return false;
+    return p->command_type == COMMAND_JOBS;
+}
+
+/* Run builtin stage p on a thread writing to its own copy of outfile.
+   infile is the pipe from the previous stage, or -1 for the first; the
+   thread drains it to EOF once the builtin is done.  */
+static int start_builtin_thread(process *p, int infile, int outfile, shell_info *shell) {
+    builtin_stage *stage = (builtin_stage *) malloc(sizeof(builtin_stage));
+    sigset_t block, saved;
+    int error;
+
+    if (!stage) return -1;
+    stage->p = p;
+    stage->shell = shell;
+    stage->infile = infile >= 0 ? fcntl(infile, F_DUPFD_CLOEXEC, 0) : -1;
+    stage->outfile = fcntl(outfile, F_DUPFD_CLOEXEC, 0);
+    if (stage->outfile < 0 || (infile >= 0 && stage->infile < 0)) {
+        if (stage->infile >= 0) close(stage->infile);
+        if (stage->outfile >= 0) close(stage->outfile);
+        free(stage);
+        return -1;
+    }
+
+    /* a reader exiting early must give the thread EPIPE, not kill
+       the shell with SIGPIPE; SIGCHLD and SIGINT are left to the
+       shell's waits */
+    sigfillset(&block);
+    pthread_sigmask(SIG_BLOCK, &block, &saved);
+    error = pthread_create(&p->thread, NULL, run_builtin_stage, stage);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (error) {
+        if (stage->infile >= 0) close(stage->infile);
+        close(stage->outfile);
+        free(stage);
+        return -1;
+    }
+    p->threaded = 1;
+    return 0;
+}
+
+/* Apply p's < and > redirections, replacing the pipeline fds.  */
+static int open_redirections(process *p, int *infile, int *outfile, job *j) {
+    int fd;
+
+    if (p->input_path) {
+        fd = open(p->input_path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "minishell: %s: %s\n", p->input_path, strerror(errno));
+            return -1;
+        }
+        if (*infile != j->stdin) close(*infile);
+        *infile = fd;
+    }
+
+    if (p->output_path) {
+        fd = open(p->output_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            fprintf(stderr, "minishell: %s: %s\n", p->output_path, strerror(errno));
+            return -1;
+        }
+        if (*outfile != j->stdout) close(*outfile);
+        *outfile = fd;
+    }
+    return 0;
+}
+
+/* Route p's stdout into a fan-out pump feeding every >(command) and
+   file target.  Consumer processes are started here and appended to
+   *consumers; they belong to the job like any other process.  */
+static int start_fanout(process *p, int *stage_out, job *j, shell_info *shell, process **consumers) {
+    fanout_target *target;
+    process *consumer;
+    int count = 0, i = 0, source[2], consumer_pipe[2], infile, outfile;
+    int *fds;
+
+    for (target = p->fanout; target; target = target->next) count++;
+    fds = (int *) malloc(count * sizeof(int));
+    if (!fds) return -1;
+
+    /* open the files first so a bad path starts nothing */
+    for (target = p->fanout; target; target = target->next, i++) {
+        fds[i] = -1;
+        if (!target->path) continue;
+        fds[i] = open(target->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fds[i] < 0) {
+            fprintf(stderr, "minishell: %s: %s\n", target->path, strerror(errno));
+            while (i-- > 0) if (fds[i] >= 0) close(fds[i]);
+            free(fds);
+            return -1;
+        }
+    }
+
+    if (pipe2(source, O_CLOEXEC) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+
+    for (target = p->fanout, i = 0; target; target = target->next, i++) {
+        if (!target->command) continue;
+
+        char *segment = strdup(target->command);
+        consumer = parse_command_segment(segment);
+        consumer->consumer = 1;
+        free(segment);
+
+        if (pipe2(consumer_pipe, O_CLOEXEC) < 0) {
+            perror("pipe");
+            exit(1);
+        }
+        infile = consumer_pipe[0];
+        outfile = j->stdout;
+        if (consumer->argc == 0 || consumer->command_type != COMMAND_EXTERNAL) {
+            fprintf(stderr, "minishell: >(%s): not an external command\n", target->command);
+            mark_process_completed(consumer);
+        } else if (open_redirections(consumer, &infile, &outfile, j) < 0) {
+            mark_process_completed(consumer);
+        } else {
+            start_process(consumer, infile, outfile, j, shell);
+        }
+        close(infile);
+        if (outfile != j->stdout) close(outfile);
+        fds[i] = consumer_pipe[1];
+
+        consumer->next = *consumers;
+        *consumers = consumer;
+    }
+
+    if (fanout_pump_start(source[0], fds, count) < 0) {
+        for (i = 0; i < count; i++) close(fds[i]);
+        close(source[0]);
+        close(source[1]);
+        free(fds);
+        return -1;
+    }
+    free(fds);
+
+    /* a redirected stage sends nothing down the pipeline */
+    if (*stage_out != j->stdout) close(*stage_out);
+    *stage_out = source[1];
+    return 0;
+}
+
+/* Wait for the single process p.  Returns true if it was stopped
+   rather than finished.  */
+static bool wait_for_process(process *p, shell_info *shell) {
+    struct rusage usage;
+    int status;
     pid_t pid;
+
+    do {
+        pid = wait4(p->pid, &status, WUNTRACED, &usage);
+    } while (pid < 0 && errno == EINTR);
+
+    if (pid > 0) mark_process_status(pid, status, &usage, shell);
+    else mark_process_completed(p);
+    return p->stopped;
+}
+
+/* Run a builtin in the shell itself, with its redirections applied.
+   Fan-out consumers join the job and are waited for once the builtin
+   is done and the pump has seen EOF.  */
+static int run_lone_builtin(process *p, job *j, shell_info *shell) {
+    int fds[3] = { j->stdin, j->stdout, j->stderr };
+    int mode = j->mode, status = 1, fanout = 0;
+    process *consumers = NULL, *c;
+    FILE *out = stdout;
+
+    if (open_redirections(p, &fds[0], &fds[1], j) < 0) return 1;
+
+    if (p->fanout) {
+        /* the consumers must not take the terminal from the shell,
+           which is still running the builtin */
+        j->mode = BACKGROUND_EXECUTION;
+        fanout = start_fanout(p, &fds[1], j, shell, &consumers);
+        j->mode = mode;
+    }
+
+    if (fanout == 0 && fds[1] != STDOUT_FILENO) {
+        out = fdopen(fcntl(fds[1], F_DUPFD_CLOEXEC, 0), "w");
+    }
+    if (fanout == 0 && out) {
+        status = run_builtin_command(p, shell, out, fds);
+        if (out != stdout) fclose(out);
+    }
+
+    if (fds[0] != j->stdin) close(fds[0]);
+    if (fds[1] != j->stdout) close(fds[1]);
+
+    p->next = consumers;
+    for (c = consumers; c; c = c->next) {
+        if (!process_is_completed(c)) wait_for_process(c, shell);
+    }
+    return status;
+}
+
+static int start_job(job *j, shell_info *shell) {
+    process *p, *consumers = NULL;
     int pipearr[2], infile, outfile;
     int status;
 
+    clock_gettime(CLOCK_REALTIME, &j->start_time);
+
+    /* forked builtins must not inherit output buffered by the shell */
+    fflush(stdout);
+    fflush(stderr);
+
     infile = j->stdin;
     for (p = j->root_process; p; p = p->next) {
         if (p->next) {
-            if (pipe(pipearr) < 0) {
+            if (pipe2(pipearr, O_CLOEXEC) < 0) {
                 perror("pipe");
                 exit(1);
             }
@@ -294,25 +939,25 @@ int launch_job(job *j, shell_info *shell) {
             outfile = j->stdout;
         }
 
-        if (p->command_type != COMMAND_EXTERNAL) {
-            status = launch_builtin_command(p, shell);
-            p->completed = 1;
+        /* a lone builtin runs in the shell itself */
+        if (p->command_type != COMMAND_EXTERNAL && p == j->root_process && !p->next) {
+            status = run_lone_builtin(p, j, shell);
+            p->status = W_EXITCODE(status & 0xff, 0);
+            mark_process_completed(p);
+            clock_gettime(CLOCK_REALTIME, &j->end_time);
+            j->launched_time = j->end_time;
             return status;
         }
 
-        pid = fork();
-        if (pid < 0) {
-            perror("fork");
-            exit(1);
-        } else if (pid == 0) {
-            /* child */
-            launch_process(p, infile, outfile, j, shell);
-        } else {
-            p->pid = pid;
-            if (shell->is_interactive) {
-                if (!j->pgid) j->pgid = pid;
-                setpgid(pid, j->pgid);
-            }
+        if (open_redirections(p, &infile, &outfile, j) < 0 ||
+                (p->fanout && start_fanout(p, &outfile, j, shell, &consumers) < 0)) {
+            p->status = W_EXITCODE(1, 0);
+            mark_process_completed(p);
+        } else if (p->command_type == COMMAND_EXTERNAL ||
+                !builtin_runs_on_thread(p, j, shell) ||
+                start_builtin_thread(p, infile != j->stdin ? infile : -1, outfile, shell) < 0) {
+            /* state-changing builtins get a forked subshell */
+            start_process(p, infile, outfile, j, shell);
         }
 
         if (infile != j->stdin) close(infile);
@@ -320,11 +965,90 @@ int launch_job(job *j, shell_info *shell) {
 
         infile = pipearr[0];
     }
+
+    /* fan-out consumers are waited for with the rest of the job */
+    for (p = j->root_process; p->next; p = p->next);
+    p->next = consumers;
+
+    clock_gettime(CLOCK_REALTIME, &j->launched_time);
     format_job_info(j, "launched");
 
     if (!shell->is_interactive) wait_for_job(j, shell);
     else if (j->mode == FOREGROUND_EXECUTION) put_job_in_foreground(j, 0, shell);
     else put_job_in_background(j, 0);
+
+    return 0;
+}
+
+static job *oldest_queued_job(shell_info *shell) {
+    job *j, *oldest = NULL;
+
+    /* newest jobs are at the head of the list */
+    for (j = shell->root_job; j; j = j->next) {
+        if (j->queued) oldest = j;
+    }
+    return oldest;
+}
+
+/* Background jobs are queued, in submission order, while pressure on
+   the machine is above the configured limits.  */
+int launch_job(job *j, shell_info *shell) {
+    admission_sample sample;
+
+    if (j->mode == BACKGROUND_EXECUTION && shell->is_interactive &&
+            admission_enabled(&shell->admission)) {
+        admission_sample_read(&sample);
+        if (oldest_queued_job(shell) || !admission_allows(&shell->admission, &sample)) {
+            j->queued = 1;
+            j->queue_id = shell->next_queue_id++;
+            format_job_info(j, "queued");
+            return 0;
+        }
+    }
+    return start_job(j, shell);
+}
+
+/* Start the oldest queued job if pressure allows.  One job per call,
+   so that the averages get to see its load before the next one.  */
+static bool admit_queued_job(shell_info *shell) {
+    admission_sample sample;
+    job *j = oldest_queued_job(shell);
+
+    if (!j) return false;
+    admission_sample_read(&sample);
+    if (!admission_allows(&shell->admission, &sample)) return false;
+
+    j->queued = 0;
+    start_job(j, shell);
+    return true;
+}
+
+/* A queued job never started: report it killed.  */
+static void drop_queued_job(job *j) {
+    process *p;
+
+    j->queued = 0;
+    clock_gettime(CLOCK_REALTIME, &j->start_time);
+    j->launched_time = j->end_time = j->start_time;
+    for (p = j->root_process; p; p = p->next) {
+        p->status = W_EXITCODE(0, SIGKILL);
+        mark_process_completed(p);
+    }
+}
+
+/* Wait for input on stdin, admitting queued jobs in the meantime.  */
+static void wait_for_input(shell_info *shell) {
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+
+    fflush(stdout);
+    while (oldest_queued_job(shell)) {
+        if (poll(&pfd, 1, ADMISSION_POLL_MS) != 0) return;
+        if (admit_queued_job(shell)) {
+            do_job_notification(shell);
+            print_prompt(shell);
+            fflush(stdout);
+        }
+    }
 }
 
 void shell_loop(shell_info *shell) {
@@ -333,12 +1057,15 @@ void shell_loop(shell_info *shell) {
     job *j;
     while (true) {
         do_job_notification(shell);
+        admit_queued_job(shell);
         print_prompt(shell);
+        wait_for_input(shell);
         line = readline();
         if (strlen(line) == 0) {
             continue;
         }
         j = parse_line(line);
+        j->submitted = 1;
         job *next = shell->root_job;
         shell->root_job = j;
         j->next = next;
@@ -377,7 +1104,7 @@ int shell_export(int argc, char *argv[]) {
         return -1;
     }
 
-    return putenv(argv[1]);
+    return putenv(strdup(argv[1]));
 }
 
 int shell_unset(int argc, char *argv[]) {
@@ -389,10 +1116,10 @@ int shell_unset(int argc, char *argv[]) {
     return unsetenv(argv[1]);
 }
 
-int shell_jobs(shell_info *shell) {
+int shell_jobs(shell_info *shell, FILE *out) {
     job *j;
     for (j = shell->root_job; j; j = j->next) {
-        print_job_info(j);
+        print_job_info(j, out);
     }
     return 0;
 }
@@ -403,6 +1130,14 @@ int shell_fg(int argc, char **argv, shell_info *shell) {
         return -1;
     }
 
+    /* a queued job is started now, bypassing admission */
+    job *queued = find_job_by_spec(argv[1], shell);
+    if (queued && queued->queued) {
+        queued->queued = 0;
+        queued->mode = FOREGROUND_EXECUTION;
+        return start_job(queued, shell);
+    }
+
     int status;
     pid_t pgid;
     pgid = atoi(argv[1]);
@@ -418,6 +1153,7 @@ int shell_fg(int argc, char **argv, shell_info *shell) {
         printf("mysh: fg %d: job not found\n", pgid);
         return -1;
     }
+    if (j) mark_job_continued(j);
 
     tcsetpgrp(0, pgid);
 
@@ -430,12 +1166,18 @@ int shell_fg(int argc, char **argv, shell_info *shell) {
     return 0;
 }
 
-int shell_bg(int argc, char **argv) {
+int shell_bg(int argc, char **argv, shell_info *shell) {
     if (argc < 2) {
         printf("usage: bg <pid>\n");
         return -1;
     }
 
+    job *queued = find_job_by_spec(argv[1], shell);
+    if (queued && queued->queued) {
+        queued->queued = 0;
+        return start_job(queued, shell);
+    }
+
     pid_t pgid;
     pgid = atoi(argv[1]);
 
@@ -448,6 +1190,8 @@ int shell_bg(int argc, char **argv) {
         printf("mysh: bg %d: job not found\n", pgid);
         return -1;
     }
+    job *j = find_job_by_pgid(pgid, shell);
+    if (j) mark_job_continued(j);
 
     return 0;
 }
@@ -458,6 +1202,13 @@ int shell_kill(int argc, char **argv, shell_info *shell) {
         return -1;
     }
 
+    /* a queued job is simply dropped from the queue */
+    job *queued = find_job_by_spec(argv[1], shell);
+    if (queued && queued->queued) {
+        drop_queued_job(queued);
+        return 1;
+    }
+
     pid_t pgid;
     pgid = atoi(argv[1]);
 
@@ -478,7 +1229,352 @@ int shell_kill(int argc, char **argv, shell_info *shell) {
     return 1;
 }
 
+/* Shell-style exit code of a wait(2) status.  */
+static int exit_code(int status) {
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
+
+int job_exit_code(job *j) {
+    return exit_code(job_last_stage(j)->status);
+}
+
+static bool job_was_launched(job *j) {
+    process *p;
+    for (p = j->root_process; p; p = p->next) {
+        if (p->pid > 0) return true;
+    }
+    return false;
+}
+
+/* Admit queued jobs, oldest first and as pressure allows, until none of
+   jobs is left queued or, with any, until one of them has started.
+   Returns -1 if interrupted by SIGINT.  */
+static int admit_waited_jobs(job **jobs, int count, bool any, shell_info *shell) {
+    struct pollfd pfd = { .events = POLLIN };
+    int i, queued, started, result = 0;
+    bool reported = false;
+    sigset_t mask, saved;
+
+    wait_signal_mask(&mask, false, shell);
+    pfd.fd = open_wait_signals(&mask, &saved);
+    if (pfd.fd < 0) return -1;
+
+    while (true) {
+        queued = started = 0;
+        for (i = 0; i < count; i++) {
+            if (jobs[i]->queued) queued++;
+            else started++;
+        }
+        if (queued == 0 || (any && started > 0)) break;
+
+        if (!reported) {
+            fprintf(stderr, "minishell: wait: %d queued job(s) waiting for admission\n", queued);
+            reported = true;
+        }
+        if (admit_queued_job(shell)) continue;
+        if (poll(&pfd, 1, ADMISSION_POLL_MS) > 0 && read_wait_signals(pfd.fd)) {
+            result = -1;
+            break;
+        }
+    }
+    close_wait_signals(pfd.fd, &saved);
+    return result;
+}
+
+/* Exit code of a finished job, or 128 + the signal that stopped it.  */
+static int job_wait_status(job *j) {
+    process *p;
+
+    if (!job_is_completed(j)) {
+        for (p = j->root_process; p; p = p->next) {
+            if (p->stopped) return 128 + WSTOPSIG(p->status);
+        }
+    }
+    return job_exit_code(j);
+}
+
+int shell_wait(int argc, char **argv, shell_info *shell) {
+    bool any = false;
+    int count = 0, size = 0, i, status;
+    job **jobs = NULL, *j;
+
+    for (i = 1; i < argc && strcmp(argv[i], "-n") == 0; i++) any = true;
+
+    if (i == argc) {
+        /* every job that has processes of its own */
+        for (j = shell->root_job; j; j = j->next) {
+            if (job_was_launched(j) || j->queued) size++;
+        }
+        jobs = (job **) malloc((size + 1) * sizeof(job *));
+        for (j = shell->root_job; j; j = j->next) {
+            if (job_was_launched(j) || j->queued) jobs[count++] = j;
+        }
+    } else {
+        jobs = (job **) malloc((argc - i) * sizeof(job *));
+        for (; i < argc; i++) {
+            j = find_job_by_spec(argv[i], shell);
+            if (!j) {
+                printf("minishell: wait: %s: no such job\n", argv[i]);
+                free(jobs);
+                return 127;
+            }
+            jobs[count++] = j;
+        }
+    }
+
+    if (count == 0) {
+        free(jobs);
+        return 0;
+    }
+
+    if (admit_waited_jobs(jobs, count, any, shell) < 0) {
+        free(jobs);
+        return 128 + SIGINT;
+    }
+    status = wait_for_jobs_pidfd(jobs, count, any, -1, shell);
+    if (status != 0) {
+        free(jobs);
+        return status == 2 ? 128 + SIGINT : 1;
+    }
+
+    /* -n reports the job that finished or stopped, otherwise the last
+       one listed */
+    status = job_wait_status(jobs[count - 1]);
+    if (any) {
+        for (i = 0; i < count; i++) {
+            if (job_is_completed(jobs[i]) || job_is_stopped(jobs[i])) {
+                status = job_wait_status(jobs[i]);
+                break;
+            }
+        }
+    }
+    free(jobs);
+    return status;
+}
+
+/* Parse a duration such as 10, 2.5s, 100ms, 1m, 1h or 1d.  */
+static int parse_duration_ms(const char *arg) {
+    char *end;
+    double value = strtod(arg, &end);
+
+    if (end == arg || value < 0) return -1;
+    if (strcmp(end, "") == 0 || strcmp(end, "s") == 0) value *= 1000;
+    else if (strcmp(end, "ms") == 0) ;
+    else if (strcmp(end, "m") == 0) value *= 60 * 1000;
+    else if (strcmp(end, "h") == 0) value *= 60 * 60 * 1000;
+    else if (strcmp(end, "d") == 0) value *= 24 * 60 * 60 * 1000;
+    else return -1;
+
+    if (value > INT_MAX) return INT_MAX;
+    return (int) value;
+}
+
+int shell_timeout(process *self, int fds[3], shell_info *shell) {
+    int argc = self->argc;
+    char **argv = self->argv;
+    int kill_after_ms = TIMEOUT_KILL_AFTER_MS, timeout_ms, i = 1, k, n;
+    size_t length = 0;
+    char *command, **words;
+    process *p;
+    job *j;
+
+    if (argc > 2 && strcmp(argv[1], "-k") == 0) {
+        kill_after_ms = parse_duration_ms(argv[2]);
+        i = 3;
+    }
+    if (argc - i < 2 || kill_after_ms < 0 || (timeout_ms = parse_duration_ms(argv[i])) < 0) {
+        printf("usage: timeout [-k DURATION] DURATION command...\n");
+        return 125;
+    }
+
+    if (get_command_type(argv[i + 1]) != COMMAND_EXTERNAL) {
+        printf("minishell: timeout: %s: not an external command\n", argv[i + 1]);
+        return 126;
+    }
+
+    /* the words are already expanded, they must not be parsed again */
+    words = (char **) malloc((argc - i) * sizeof(char *));
+    for (k = i + 1, n = 0; k < argc; k++) {
+        words[n++] = strdup(argv[k]);
+        length += strlen(argv[k]) + 1;
+    }
+    words[n] = NULL;
+
+    /* the job's command is only shown, never parsed */
+    command = (char *) malloc(length + 1);
+    command[0] = '\0';
+    for (k = 0; k < n; k++) {
+        strcat(command, words[k]);
+        if (k + 1 < n) strcat(command, " ");
+    }
+
+    p = new_process_from_argv(strdup(words[0]), n, words);
+    j = new_job(command, p, FOREGROUND_EXECUTION);
+
+    /* the redirections of the timeout stage were applied to fds */
+    j->stdin = fds[0];
+    j->stdout = fds[1];
+    j->stderr = fds[2];
+    j->timeout_ms = timeout_ms;
+    j->kill_after_ms = kill_after_ms;
+    j->next = shell->root_job;
+    shell->root_job = j;
+
+    launch_job(j, shell);
+
+    if (j->timed_out) return 124;
+    return job_wait_status(j);
+}
+
+/* Bytes a single argument costs against ARG_MAX.  */
+static long exec_arg_size(const char *arg) {
+    return strlen(arg) + 1 + sizeof(char *);
+}
+
+/* Room left for arguments once the environment is accounted for.  */
+static long exec_arg_space() {
+    extern char **environ;
+    long space = sysconf(_SC_ARG_MAX) - BATCH_HEADROOM;
+    char **env;
+
+    if (space <= 0) space = _POSIX_ARG_MAX - BATCH_HEADROOM;
+    for (env = environ; *env; env++) space -= exec_arg_size(*env);
+    return space - sizeof(char *);
+}
+
+/* Exit code summarising several runs, as xargs does.  */
+static int batch_exit_code(int status) {
+    if (WIFSIGNALED(status)) return 125;
+    if (WEXITSTATUS(status) == 255) return 124;
+    if (WEXITSTATUS(status) != 0) return 123;
+    return 0;
+}
+
+/*
+batch [-P N] command arg...
+
+Run command over its arguments in as many invocations as ARG_MAX
+requires, at most N at a time.  The words produced by glob expansion are
+split across invocations; arguments before and after them are repeated
+in each one.  Without a glob, every argument after the command is split.
+*/
+int shell_batch(process *self, int fds[3], shell_info *shell) {
+    int argc = self->argc, parallel = 1, start = 1, first, last;
+    int i, k, m, n, running = 0, result = 0;
+    bool stopped = false;
+    char **argv = self->argv, **chunk;
+    long space, fixed = 0, size;
+    process *p, *tail = NULL, *waiting;
+    job *j;
+
+    if (argc > 2 && strcmp(argv[1], "-P") == 0) {
+        parallel = atoi(argv[2]);
+        start = 3;
+    }
+    if (start >= argc || parallel < 1) {
+        printf("usage: batch [-P N] command arg...\n");
+        return -1;
+    }
+
+    first = start + 1;
+    last = argc;
+    if (self->expanded_start > start) {
+        first = self->expanded_start;
+        last = self->expanded_end;
+    }
+
+    space = exec_arg_space();
+    for (i = start; i < argc; i++) {
+        if (i < first || i >= last) fixed += exec_arg_size(argv[i]);
+    }
+    if (fixed >= space) {
+        printf("minishell: batch: %s: %s\n", argv[start], strerror(E2BIG));
+        return 126;
+    }
+
+    j = new_job(strdup(self->command), NULL, FOREGROUND_EXECUTION);
+    /* the redirections of the batch stage were applied to fds */
+    j->stdin = fds[0];
+    j->stdout = fds[1];
+    j->stderr = fds[2];
+    j->next = shell->root_job;
+    shell->root_job = j;
+    clock_gettime(CLOCK_REALTIME, &j->start_time);
+    fflush(stdout);
+
+    waiting = NULL;
+    i = first;
+    do {
+        /* bounded parallelism: wait for the oldest run in flight */
+        while (running >= parallel && !stopped) {
+            stopped = wait_for_process(waiting, shell);
+            waiting = waiting->next;
+            running--;
+        }
+        if (stopped) break;
+
+        /* take as many words as fit, but always at least one */
+        size = fixed;
+        for (k = i; k < last && (k == i || size + exec_arg_size(argv[k]) <= space); k++) {
+            size += exec_arg_size(argv[k]);
+        }
+
+        chunk = (char **) malloc((argc - (last - first) + (k - i) + 1) * sizeof(char *));
+        n = 0;
+        for (m = start; m < first; m++) chunk[n++] = strdup(argv[m]);
+        for (m = i; m < k; m++) chunk[n++] = strdup(argv[m]);
+        for (m = last; m < argc; m++) chunk[n++] = strdup(argv[m]);
+        chunk[n] = NULL;
+
+        p = new_process_from_argv(strdup(argv[start]), n, chunk);
+        p->command_type = COMMAND_EXTERNAL;
+        if (tail) tail->next = p;
+        else j->root_process = p;
+        tail = p;
+        if (!waiting) waiting = p;
+
+        start_process(p, j->stdin, j->stdout, j, shell);
+        running++;
+        if (shell->is_interactive && p == j->root_process) {
+            tcsetpgrp(shell->shell_terminal, j->pgid);
+        }
+
+        i = k;
+    } while (i < last);
+
+    for (; waiting && !stopped; waiting = waiting->next) {
+        if (!process_is_completed(waiting)) stopped = wait_for_process(waiting, shell);
+    }
+    if (shell->is_interactive) {
+        tcsetpgrp(shell->shell_terminal, shell->shell_pgid);
+        tcgetattr(shell->shell_terminal, &j->tmodes);
+        tcsetattr(shell->shell_terminal, TCSADRAIN, &shell->shell_tmodes);
+    }
+
+    /* like a stopped foreground job: back to the prompt, fg resumes the
+       runs already started; the remaining words are dropped */
+    if (stopped) {
+        if (i < last) {
+            fprintf(stderr, "minishell: batch: stopped, %d argument(s) not run\n", last - i);
+        }
+        return 128 + SIGTSTP;
+    }
+
+    for (p = j->root_process; p; p = p->next) {
+        if (batch_exit_code(p->status) > result) result = batch_exit_code(p->status);
+    }
+    return result;
+}
+
 int launch_builtin_command(process *p, shell_info *shell) {
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    return run_builtin_command(p, shell, stdout, fds);
+}
+
+/* Run builtin p writing its regular output to out.  fds are the stdin,
+   stdout and stderr that jobs started by the builtin inherit.  */
+int run_builtin_command(process *p, shell_info *shell, FILE *out, int fds[3]) {
     int status;
     switch (p->command_type) {
         case COMMAND_EXIT:
@@ -495,17 +1591,26 @@ int launch_builtin_command(process *p, shell_info *shell) {
             status = shell_unset(p->argc, p->argv);
             break;
         case COMMAND_JOBS:
-            status = shell_jobs(shell);
+            status = shell_jobs(shell, out);
             break;
         case COMMAND_FG:
             status = shell_fg(p->argc, p->argv, shell);
             break;
         case COMMAND_BG:
-            status = shell_bg(p->argc, p->argv);
+            status = shell_bg(p->argc, p->argv, shell);
             break;
         case COMMAND_KILL:
             status = shell_kill(p->argc, p->argv, shell);
             break;
+        case COMMAND_WAIT:
+            status = shell_wait(p->argc, p->argv, shell);
+            break;
+        case COMMAND_TIMEOUT:
+            status = shell_timeout(p, fds, shell);
+            break;
+        case COMMAND_BATCH:
+            status = shell_batch(p, fds, shell);
+            break;
         default:
             status = 0;
             break;
@@ -14,9 +14,22 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <glob.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/signalfd.h>
 #include "parser.h"
+#include "spawn.h"
+#include "fanout.h"
+#include "audit.h"
+#include "admission.h"
 
 #define PATH_BUFSIZE 1024
+#define TIMEOUT_KILL_AFTER_MS 2000
+#define BATCH_HEADROOM 2048
+#define BUILTIN_DRAIN_SIZE 65536
+#define RECORD_HEADER "# minishell session v1: offset_ns exit_code command"
 
 #define COMMAND_EXTERNAL 0
 #define COMMAND_EXIT 1
@@ -37,17 +50,30 @@ typedef struct shell_info {
     struct termios shell_tmodes;
     pid_t shell_pgid;
     job *root_job;
+    int spawn_helper;       /* socket to the spawn helper, or -1 */
+    audit_log *audit;       /* finished-job log, or NULL */
+    FILE *record;           /* session recording, or NULL */
+    struct timespec record_start;
+    admission_limits admission;     /* for background jobs */
+    int next_queue_id;
 } shell_info;
 
 shell_info *init_shell();
+shell_info *init_noninteractive_shell();
 
 int launch_process(process *p, int infile, int outfile, job *j, shell_info* shell);
 void shell_print_welcome();
 void shell_loop(shell_info *shell);
+int launch_job(job *j, shell_info *shell);
+void do_job_notification(shell_info *shell);
+void free_job(job *j);
 void update_cwd_info();
 void print_prompt();
 int get_command_type(char *command);
 void launch_command(char *command);
 int launch_builtin_command(process *p, shell_info *shell);
+int run_builtin_command(process *p, shell_info *shell, FILE *out, int fds[3]);
+int job_exit_code(job *j);
+int record_open(shell_info *shell, const char *path);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include "spawn.h"
+
+/*
+The spawn helper is forked once at startup, while the shell is still
+small, and performs every later fork/exec on the shell's behalf.  The
+page tables copied at fork time are the helper's, so launch cost does
+not grow with the shell's history, caches or job list.
+
+Children are created with CLONE_PARENT, which makes them children of
+the shell rather than of the helper: waitpid, SIGCHLD and all the job
+control bookkeeping keep working unchanged in the shell.
+*/
+
+static int send_full(int fd, const void *buf, size_t len) {
+    const char *cursor = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        n = send(fd, cursor, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        cursor += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *cursor = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        n = read(fd, cursor, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        cursor += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_request(int sock, spawn_request *request, int fds[3]) {
+    struct iovec iov = { .iov_base = request, .iov_len = sizeof(*request) };
+    union {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg;
+    ssize_t n;
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+            cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+
+    if ((size_t) n < sizeof(*request) &&
+            read_full(sock, (char *) request + n, sizeof(*request) - n) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Runs in the new child; never returns.  */
+static void exec_child(spawn_request *request, char *cwd, char **argv,
+                       char **envp, int fds[3]) {
+    int i;
+
+    if (request->pgid != SPAWN_NO_PGID) {
+        setpgid(0, request->pgid);
+        if (request->foreground) tcsetpgrp(STDIN_FILENO, request->pgid ? request->pgid : getpid());
+    }
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+
+    /* received fds are close-on-exec, dup2 clears the flag on 0-2 */
+    for (i = 0; i < 3; i++) {
+        dup2(fds[i], i);
+    }
+
+    if (chdir(cwd) < 0) {
+        dprintf(STDERR_FILENO, "minishell: %s: %s\n", cwd, strerror(errno));
+    }
+
+    execve(argv[0], argv, envp);
+    if (errno == E2BIG) {
+        dprintf(STDERR_FILENO, "minishell: %s: argument list too long (see batch)\n", argv[0]);
+        _exit(126);
+    } else if (errno != ENOENT) {
+        dprintf(STDERR_FILENO, "minishell: %s: %s\n", argv[0], strerror(errno));
+        _exit(126);
+    }
+    dprintf(STDOUT_FILENO, "minishell: %s: command not found\n", argv[0]);
+    _exit(0);
+}
+
+static void serve_requests(int sock) {
+    spawn_request request;
+    spawn_reply reply;
+    char *buffer = NULL, *cursor;
+    char **vectors = NULL;
+    size_t vectors_size = 0;
+    int fds[3], i;
+    long pid;
+
+    while (recv_request(sock, &request, fds) == 0) {
+        reply.pid = -1;
+        reply.error = 0;
+
+        buffer = realloc(buffer, request.length + 1);
+        if (request.argc + request.envc + 2 > vectors_size) {
+            vectors_size = request.argc + request.envc + 2;
+            vectors = realloc(vectors, vectors_size * sizeof(char *));
+        }
+        if (!buffer || !vectors) exit(EXIT_FAILURE);
+        if (read_full(sock, buffer, request.length) < 0) exit(EXIT_FAILURE);
+        buffer[request.length] = '\0';
+
+        /* cwd, then argv and envp laid out back to back */
+        cursor = buffer + strlen(buffer) + 1;
+        for (i = 0; i < (int) (request.argc + request.envc); i++) {
+            vectors[i + (i >= (int) request.argc)] = cursor;
+            cursor += strlen(cursor) + 1;
+        }
+        vectors[request.argc] = NULL;
+        vectors[request.argc + request.envc + 1] = NULL;
+
+        pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+        if (pid == 0) {
+            exec_child(&request, buffer, vectors, vectors + request.argc + 1, fds);
+        } else if (pid < 0) {
+            reply.error = errno;
+        } else {
+            reply.pid = pid;
+        }
+
+        for (i = 0; i < 3; i++) {
+            close(fds[i]);
+        }
+        if (send_full(sock, &reply, sizeof(reply)) < 0) break;
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/* Fork the helper.  Returns the shell's end of the request socket, or
+   -1 if the helper could not be started.  */
+int spawn_helper_start() {
+    int sv[2];
+    pid_t pid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        perror("socketpair");
+        return -1;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    } else if (pid == 0) {
+        /* helper: die with the shell, ignore terminal signals */
+        close(sv[0]);
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        signal(SIGINT, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+        signal(SIGTTOU, SIG_IGN);
+        serve_requests(sv[1]);
+    }
+
+    close(sv[1]);
+    return sv[0];
+}
+
+static size_t pack_strings(char *dest, char **strings, uint32_t *count) {
+    size_t length = 0, n;
+    int i;
+
+    for (i = 0; strings[i]; i++) {
+        n = strlen(strings[i]) + 1;
+        if (dest) memcpy(dest + length, strings[i], n);
+        length += n;
+    }
+    *count = i;
+    return length;
+}
+
+/* Ask the helper to start argv[0] with the given stdin/stdout/stderr.
+   Returns the pid, which is a child of the calling process, or -1
+   with errno set.  */
+pid_t spawn_process(int helper, char **argv, char **envp, const char *cwd,
+                    int fds[3], pid_t pgid, int foreground) {
+    spawn_request request;
+    spawn_reply reply;
+    size_t cwd_length = strlen(cwd) + 1, argv_length, envp_length;
+    char *buffer;
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg;
+    ssize_t n;
+
+    argv_length = pack_strings(NULL, argv, &request.argc);
+    envp_length = pack_strings(NULL, envp, &request.envc);
+    request.length = cwd_length + argv_length + envp_length;
+    request.pgid = pgid;
+    request.foreground = foreground;
+
+    buffer = malloc(request.length);
+    if (!buffer) return -1;
+    memcpy(buffer, cwd, cwd_length);
+    pack_strings(buffer + cwd_length, argv, &request.argc);
+    pack_strings(buffer + cwd_length + argv_length, envp, &request.envc);
+
+    iov.iov_base = &request;
+    iov.iov_len = sizeof(request);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+
+    do {
+        n = sendmsg(helper, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0 ||
+            send_full(helper, (char *) &request + n, sizeof(request) - n) < 0 ||
+            send_full(helper, buffer, request.length) < 0 ||
+            read_full(helper, &reply, sizeof(reply)) < 0) {
+        free(buffer);
+        errno = EPIPE;
+        return SPAWN_HELPER_LOST;
+    }
+    free(buffer);
+
+    if (reply.pid < 0) {
+        errno = reply.error;
+        return -1;
+    }
+    return reply.pid;
+}
@@ -0,0 +1,37 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define SPAWN_NO_PGID -1
+#define SPAWN_HELPER_LOST -2     /* spawn_process could not talk to the helper */
+
+/*
+Launch request sent from the shell to the spawn helper.  The job's
+stdin, stdout and stderr travel with the header as SCM_RIGHTS; the
+header is followed by `length` bytes holding the working directory,
+then argc argument strings and envc environment strings, each
+NUL-terminated.
+*/
+typedef struct spawn_request {
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t length;
+    int32_t pgid;           /* SPAWN_NO_PGID leaves the process group alone */
+    int32_t foreground;     /* give the terminal to pgid */
+} spawn_request;
+
+typedef struct spawn_reply {
+    int32_t pid;
+    int32_t error;
+} spawn_reply;
+
+int spawn_helper_start();
+/* Returns the child's pid, -1 with errno set if the helper could not
+   start it, or SPAWN_HELPER_LOST if the helper is gone.  */
+pid_t spawn_process(int helper, char **argv, char **envp, const char *cwd,
+                    int fds[3], pid_t pgid, int foreground);
+
+#endif
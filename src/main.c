@@ -1,8 +1,99 @@
 #include "lib/shell.h"
+#include "lib/server.h"
+#include "lib/audit.h"
+#include "lib/replay.h"
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [--spawn-helper] [--audit-log FILE [--audit-records N]]\n"
+            "       [--admit-cpu PCT] [--admit-memory PCT] [--admit-load PER_CPU]\n"
+            "       [--record FILE | --replay FILE [--fast]]\n"
+            "       [--server PATH [--max-jobs N]]\n", name);
+    return EXIT_FAILURE;
+}
 
 int main (int argc, char* argv[]) {
+    char *server_path = NULL;
+    int max_jobs = SERVER_DEFAULT_MAX_JOBS;
+    int use_spawn_helper = 0, spawn_helper = -1;
+    char *audit_path = NULL;
+    int audit_records = AUDIT_DEFAULT_RECORDS;
+    audit_log *audit = NULL;
+    char *record_path = NULL, *replay_path = NULL;
+    bool replay_fast = false;
+    admission_limits admission;
+    int i;
+
+    admission_limits_init(&admission);
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if (strcmp(argv[i], "--max-jobs") == 0 && i + 1 < argc) {
+            max_jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--spawn-helper") == 0) {
+            use_spawn_helper = 1;
+        } else if (strcmp(argv[i], "--audit-log") == 0 && i + 1 < argc) {
+            audit_path = argv[++i];
+        } else if (strcmp(argv[i], "--audit-records") == 0 && i + 1 < argc) {
+            audit_records = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--fast") == 0) {
+            replay_fast = true;
+        } else if (strcmp(argv[i], "--admit-cpu") == 0 && i + 1 < argc) {
+            admission.cpu_some = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--admit-memory") == 0 && i + 1 < argc) {
+            admission.memory_some = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--admit-load") == 0 && i + 1 < argc) {
+            admission.load = atof(argv[++i]);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    if (replay_fast && !replay_path) {
+        fprintf(stderr, "minishell: --fast needs --replay\n");
+        return EXIT_FAILURE;
+    }
+    if (record_path && (replay_path || server_path)) {
+        fprintf(stderr, "minishell: --record only applies to an interactive session\n");
+        return EXIT_FAILURE;
+    }
+
+    /* children of the helper are not children of a server worker */
+    if (use_spawn_helper && server_path) {
+        fprintf(stderr, "minishell: --spawn-helper cannot be used with --server\n");
+        return EXIT_FAILURE;
+    }
+
+    if (audit_path) {
+        audit = audit_open(audit_path, audit_records > 0 ? audit_records : 0);
+        if (!audit) return EXIT_FAILURE;
+    }
+
+    /* fork the helper before the shell allocates anything */
+    if (use_spawn_helper) spawn_helper = spawn_helper_start();
+
+    if (replay_path) {
+        shell_info *shell = init_noninteractive_shell();
+        shell->spawn_helper = spawn_helper;
+        shell->audit = audit;
+        return replay_session(shell, replay_path, replay_fast) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (server_path) {
+        shell_info *shell = init_noninteractive_shell();
+        shell->audit = audit;
+        return shell_server(shell, server_path, max_jobs) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
     shell_info *shell = init_shell();
+    shell->spawn_helper = spawn_helper;
+    shell->audit = audit;
+    shell->admission = admission;
+    if (record_path && record_open(shell, record_path) < 0) return EXIT_FAILURE;
     shell_print_welcome(); 
     shell_loop(shell);
     return 0;
-}
\ No newline at end of file
+}